@@ -0,0 +1,86 @@
+#pragma once
+
+#include <sys/mman.h>
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "checkpoint.h"
+
+// Fixed-size array of a trivially copyable type in one 64-byte aligned allocation.
+// Arrays of 2MB or more start on a 2MB boundary and are advised as transparent huge pages,
+// so a large simulated memory costs the host few TLB entries.
+template <typename T>
+class AlignedArray {
+  static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+  static constexpr size_t CACHE_LINE_SIZE = 64;
+  static constexpr size_t HUGE_PAGE_SIZE = 2 << 20;
+
+  AlignedArray() = default;
+
+  explicit AlignedArray(size_t count, const T& value = T {}) : count(count) {
+    if (count == 0) return;
+
+    size_t bytes = count * sizeof(T);
+    size_t align = bytes >= HUGE_PAGE_SIZE ? HUGE_PAGE_SIZE : CACHE_LINE_SIZE;
+    // aligned_alloc wants a multiple of the alignment
+    bytes = (bytes + align - 1) / align * align;
+    items = static_cast<T *>(std::aligned_alloc(align, bytes));
+    if (items == nullptr) throw std::bad_alloc();
+    if (align == HUGE_PAGE_SIZE) {
+      madvise(items, bytes, MADV_HUGEPAGE);
+    }
+    for (size_t i = 0; i < count; i++) {
+      items[i] = value;
+    }
+  }
+
+  AlignedArray(AlignedArray&& other) noexcept : items(other.items), count(other.count) {
+    other.items = nullptr;
+    other.count = 0;
+  }
+
+  AlignedArray& operator=(AlignedArray&& other) noexcept {
+    std::swap(items, other.items);
+    std::swap(count, other.count);
+    return *this;
+  }
+
+  AlignedArray(const AlignedArray&) = delete;
+  AlignedArray& operator=(const AlignedArray&) = delete;
+
+  ~AlignedArray() { std::free(items); }
+
+  size_t size() const { return count; }
+
+  T *data() { return items; }
+  const T *data() const { return items; }
+
+  T& operator[](size_t i) { return items[i]; }
+  const T& operator[](size_t i) const { return items[i]; }
+
+  // Same layout as CheckpointWriter::write_vector().
+  void save(CheckpointWriter& out) const {
+    out.write<uint64_t>(count);
+    out.write_bytes(items, count * sizeof(T));
+  }
+
+  // The array keeps its size, a checkpoint of another size is rejected.
+  void load(CheckpointReader& in) {
+    if (in.read<uint64_t>() != count) {
+      in.fail();
+      return;
+    }
+    in.read_bytes(items, count * sizeof(T));
+  }
+
+private:
+  T *items {nullptr};
+  size_t count {0};
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Minimal binary serialization used to checkpoint simulator state.
+// Values are written in host byte order, checkpoints are not meant to move between machines.
+class CheckpointWriter {
+public:
+  explicit CheckpointWriter(FILE *file) : file(file) {}
+
+  bool good() const { return ok; }
+
+  template <typename T>
+  void write(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    ok = ok && std::fwrite(&value, sizeof(T), 1, file) == 1;
+  }
+
+  void write_bytes(const void *data, size_t size) {
+    ok = ok && std::fwrite(data, 1, size, file) == size;
+  }
+
+  void write_string(const std::string& str) {
+    write<uint64_t>(str.size());
+    ok = ok && std::fwrite(str.data(), 1, str.size(), file) == str.size();
+  }
+
+  template <typename T>
+  void write_vector(const std::vector<T>& vec) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    write<uint64_t>(vec.size());
+    ok = ok && std::fwrite(vec.data(), sizeof(T), vec.size(), file) == vec.size();
+  }
+
+private:
+  FILE *file;
+  bool ok {true};
+};
+
+class CheckpointReader {
+public:
+  explicit CheckpointReader(FILE *file) : file(file) {}
+
+  bool good() const { return ok; }
+
+  // Marks the checkpoint as unusable, e.g. when it was taken with another geometry.
+  void fail() { ok = false; }
+
+  template <typename T>
+  T read() {
+    static_assert(std::is_trivially_copyable_v<T>);
+    T value {};
+    ok = ok && std::fread(&value, sizeof(T), 1, file) == 1;
+    return value;
+  }
+
+  template <typename T>
+  void read(T& value) {
+    value = read<T>();
+  }
+
+  void read_bytes(void *data, size_t size) {
+    ok = ok && std::fread(data, 1, size, file) == size;
+  }
+
+  std::string read_string() {
+    std::string str(read<uint64_t>(), '\0');
+    ok = ok && std::fread(str.data(), 1, str.size(), file) == str.size();
+    return str;
+  }
+
+  template <typename T>
+  void read_vector(std::vector<T>& vec) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    vec.resize(read<uint64_t>());
+    ok = ok && std::fread(vec.data(), sizeof(T), vec.size(), file) == vec.size();
+  }
+
+private:
+  FILE *file;
+  bool ok {true};
+};
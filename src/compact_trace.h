@@ -0,0 +1,190 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+#include "trace_record.h"
+
+// Compact trace format
+// --------------------
+// file   := header block*
+// header := magic[8] = "TLBCTRC1", uint32 block_records
+// block  := uint32 record_count, uint32 payload_size, payload[payload_size], 0[BLOCK_PADDING]
+//
+// Each record in the payload is one LEB128 varint v:
+//   v & 3 in {0, 1, 2}: type R, W or I; v >> 2 is the zig-zag encoded delta from the
+//                       previous address
+//   v == 3:             escape, followed by the raw type byte and the raw 8-byte address
+//                       (types other than R/W/I, or deltas that do not fit in 62 bits)
+// The previous address is reset to 0 at the start of every block, so blocks can be
+// decoded independently. The zero padding lets the decoder always load 8 bytes at once.
+namespace compact_trace {
+
+constexpr char MAGIC[8] = {'T', 'L', 'B', 'C', 'T', 'R', 'C', '1'};
+constexpr size_t FILE_HEADER_SIZE = sizeof(MAGIC) + sizeof(uint32_t);
+constexpr size_t BLOCK_HEADER_SIZE = 2 * sizeof(uint32_t);
+constexpr size_t BLOCK_PADDING = 8;
+// most bytes a record can read, even a corrupt one: a 10-byte varint, then the raw type byte
+// and address of an escape
+constexpr size_t MAX_RECORD_SIZE = 10 + 1 + sizeof(uint64_t);
+constexpr uint32_t DEFAULT_BLOCK_RECORDS = 1 << 16;
+
+constexpr uint64_t TAG_BITS = 2;
+constexpr uint64_t TAG_ESCAPE = 3;
+constexpr char TAG_TYPES[3] = {'R', 'W', 'I'};
+
+inline bool has_magic(const char *p, size_t size) {
+  return size >= sizeof(MAGIC) && std::memcmp(p, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+inline uint64_t zigzag_encode(uint64_t delta) {
+  return (delta << 1) ^ (uint64_t)((int64_t)delta >> 63);
+}
+
+inline uint64_t zigzag_decode(uint64_t zz) {
+  return (zz >> 1) ^ (0 - (zz & 1));
+}
+
+inline void write_varint(std::vector<uint8_t>& buf, uint64_t v) {
+  while (v >= 0x80) {
+    buf.push_back((uint8_t)v | 0x80);
+    v >>= 7;
+  }
+  buf.push_back((uint8_t)v);
+}
+
+// Reads a varint. At least 8 bytes must be readable at `p`.
+inline uint64_t read_varint(const uint8_t *& p) {
+  uint64_t word;
+  std::memcpy(&word, p, sizeof(word));
+  uint64_t stop = ~word & 0x8080808080808080ULL;
+
+  if (stop != 0) {
+    // the varint ends within these 8 bytes, gather its 7-bit groups without a loop
+    p += (__builtin_ctzll(stop) >> 3) + 1;
+    word &= stop ^ (stop - 1);
+#ifdef __BMI2__
+    return _pext_u64(word, 0x7f7f7f7f7f7f7f7fULL);
+#else
+    return (word & 0x7fULL) | ((word >> 1) & (0x7fULL << 7)) | ((word >> 2) & (0x7fULL << 14)) |
+           ((word >> 3) & (0x7fULL << 21)) | ((word >> 4) & (0x7fULL << 28)) |
+           ((word >> 5) & (0x7fULL << 35)) | ((word >> 6) & (0x7fULL << 42)) |
+           ((word >> 7) & (0x7fULL << 49));
+#endif
+  }
+
+  uint64_t v = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    uint8_t byte = *p++;
+    v |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) break;
+  }
+  return v;
+}
+
+inline void decode_record(const uint8_t *& p, uint64_t& prev, TraceRecord& out) {
+  uint64_t v = read_varint(p);
+  uint64_t tag = v & TAG_ESCAPE;
+  if (tag != TAG_ESCAPE) {
+    prev += zigzag_decode(v >> TAG_BITS);
+    out.rw = TAG_TYPES[tag];
+  }
+  else {
+    out.rw = (char)*p++;
+    std::memcpy(&prev, p, sizeof(prev));
+    p += sizeof(prev);
+  }
+  out.addr = prev;
+}
+
+// Decodes `n` records of a block payload starting at `p` and ending at `end`, continuing from
+// address `prev`. Returns false if the records run past `end`, the block is corrupt then.
+// Nothing at or after `end` is read.
+inline bool decode_records(const uint8_t *& p, const uint8_t *end, uint64_t& prev,
+                           TraceRecord *out, size_t n) {
+  size_t i = 0;
+  for (; i < n && (size_t)(end - p) >= MAX_RECORD_SIZE; i++) {
+    decode_record(p, prev, out[i]);
+  }
+  if (i == n) return p <= end;
+
+  // the last records of a block are decoded from a zero-padded copy
+  uint8_t tail[2 * MAX_RECORD_SIZE] = {};
+  size_t left = end - p;
+  std::memcpy(tail, p, left);
+  const uint8_t *q = tail;
+  for (; i < n; i++) {
+    if (q >= tail + left) return false;
+    decode_record(q, prev, out[i]);
+  }
+  p += q - tail;
+  return p <= end;
+}
+
+// Encodes records into the compact format and writes them to a file block by block.
+class CompactTraceWriter {
+public:
+  CompactTraceWriter(FILE *file, uint32_t block_records = DEFAULT_BLOCK_RECORDS)
+      : file(file), block_records(block_records) {
+    std::fwrite(MAGIC, sizeof(MAGIC), 1, file);
+    std::fwrite(&block_records, sizeof(block_records), 1, file);
+    bytes_written += FILE_HEADER_SIZE;
+  }
+
+  ~CompactTraceWriter() { flush(); }
+
+  void append(const TraceRecord& rec) {
+    uint64_t zz = zigzag_encode(rec.addr - prev);
+    int tag = rec.rw == 'R' ? 0 : rec.rw == 'W' ? 1 : rec.rw == 'I' ? 2 : TAG_ESCAPE;
+
+    if (tag != TAG_ESCAPE && zz >> (64 - TAG_BITS) == 0) {
+      write_varint(payload, (zz << TAG_BITS) | tag);
+    }
+    else {
+      write_varint(payload, TAG_ESCAPE);
+      payload.push_back((uint8_t)rec.rw);
+      const uint8_t *raw = reinterpret_cast<const uint8_t *>(&rec.addr);
+      payload.insert(payload.end(), raw, raw + sizeof(rec.addr));
+    }
+    prev = rec.addr;
+
+    if (++record_count == block_records) {
+      flush();
+    }
+  }
+
+  // Writes out the pending block, if any.
+  void flush() {
+    if (record_count == 0) return;
+
+    uint32_t payload_size = payload.size();
+    payload.resize(payload.size() + BLOCK_PADDING, 0);
+    std::fwrite(&record_count, sizeof(record_count), 1, file);
+    std::fwrite(&payload_size, sizeof(payload_size), 1, file);
+    std::fwrite(payload.data(), 1, payload.size(), file);
+    bytes_written += BLOCK_HEADER_SIZE + payload.size();
+
+    payload.clear();
+    record_count = 0;
+    prev = 0;
+  }
+
+  uint64_t get_bytes_written() const { return bytes_written; }
+
+private:
+  FILE *file;
+  uint32_t block_records;
+
+  std::vector<uint8_t> payload;
+  uint32_t record_count {0};
+  uint64_t prev {0};
+  uint64_t bytes_written {0};
+};
+
+}  // namespace compact_trace
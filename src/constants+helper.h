@@ -6,6 +6,28 @@ constexpr int PAGE_SIZE_KB = 4;
 constexpr int PAGE_SIZE_BITS = 12;
 
 
+// bits of the access types seen in a run of accesses
+constexpr uint8_t ACCESS_READ = 1;
+constexpr uint8_t ACCESS_WRITE = 2;
+constexpr uint8_t ACCESS_INST = 4;
+
 uint64_t get_page_number(uint64_t vpn) {
   return vpn >> PAGE_SIZE_BITS;
+}
+
+// The address space ID of a trace goes above the page number bits, so the same page of two
+// traces never aliases.
+constexpr int ASID_SHIFT = 64 - PAGE_SIZE_BITS;
+
+inline uint64_t get_tagged_page_number(uint64_t addr, uint8_t asid) {
+  return get_page_number(addr) | (uint64_t)asid << ASID_SHIFT;
+}
+
+inline uint8_t get_access_type_mask(char rw) {
+  switch (rw) {
+    case 'R': case 'r': return ACCESS_READ;
+    case 'W': case 'w': return ACCESS_WRITE;
+    case 'I': case 'i': return ACCESS_INST;
+    default: return 0;
+  }
 }
\ No newline at end of file
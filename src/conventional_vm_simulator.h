@@ -2,50 +2,97 @@
 
 #include "vm_simulator.h"
 #include "constants+helper.h"
+#include "flat_page_table.h"
+#include "page_frame.h"
 
-#include <unordered_map>
-#include <list>
+#include <vector>
 
-class ConventionalVmSimulator : public VmSimulator {
+// Fully associative memory with exact LRU replacement. The LRU list is intrusive: frames are
+// preallocated nodes linked by 32-bit indices, in a circular list through a sentinel node, and
+// unused frames are chained on a free list. A hit unlinks one node and relinks it at the tail.
+class ConventionalVmSimulator final : public SimulatorKernel<ConventionalVmSimulator> {
 
 public:
-  ConventionalVmSimulator(double mem_size_mb) {
-    num_frames = mem_size_mb * 1024 / PAGE_SIZE_KB;
-
+  ConventionalVmSimulator(double mem_size_mb)
+      : num_frames(mem_size_mb * 1024 / PAGE_SIZE_KB), page_table(num_frames) {
+    reset_frames();
     print_info();
   }
 
-  void access(uint64_t addr, char rw) override {
+  void access_run(uint64_t vpn, uint64_t count, uint8_t rw_mask) override {
     time_tick += 1;
-    stats.total_mem_access += 1;
+    stats.total_mem_access += count;
 
-    uint64_t vpn = get_page_number(addr);
-    vpn_set.insert(vpn);
+    footprint.insert(vpn);
 
-    auto find_res = page_table.find(vpn);
+    auto *find_res = page_table.find(vpn);
+    uint32_t frame;
 
-    if (find_res != page_table.end()) {
+    if (find_res != nullptr) {
       // move this page to the end (most recent used position) of the list.
-      lru_queue.splice(lru_queue.end(), lru_queue, find_res->second);
-      lru_queue.back().timestamp = time_tick;
+      frame = *find_res;
+      unlink(frame);
     }
     else {
       stats.num_page_fault += 1;
 
-      if (page_table.size() >= num_frames) {
+      if (free_head == NIL) {
         stats.num_swap_out += 1;
 
-        PageFrame& victim = lru_queue.front();
-        stats.total_age_of_swapped_out_pages += time_tick - victim.timestamp;
-        page_table.erase(victim.vpn);
-
-        lru_queue.pop_front();
+        frame = nodes[sentinel()].next;
+        stats.total_age_of_swapped_out_pages += time_tick - nodes[frame].timestamp;
+        page_table.erase(nodes[frame].vpn);
+        unlink(frame);
+      }
+      else {
+        frame = free_head;
+        free_head = nodes[frame].next;
       }
 
-      lru_queue.emplace_back(vpn, time_tick, false);
+      nodes[frame].vpn = vpn;
+      page_table.insert_or_assign(vpn, frame);
+    }
+
+    link_back(frame);
+
+    // the rest of the run hits the same page
+    time_tick += count - 1;
+    nodes[frame].timestamp = time_tick;
+  }
+
+  void prefetch_lookup(uint64_t vpn) const {
+    page_table.prefetch(vpn);
+  }
+
+  void prefetch_frame(uint64_t vpn) {
+    if (auto *frame = page_table.find(vpn)) {
+      __builtin_prefetch(&nodes[*frame], 1);
+    }
+  }
+
+  void save_state(CheckpointWriter& out) override {
+    VmSimulator::save_state(out);
+    // in LRU order, page_table is rebuilt from it
+    out.write<uint64_t>(page_table.size());
+    for (uint32_t i = nodes[sentinel()].next; i != sentinel(); i = nodes[i].next) {
+      out.write(PageFrame(nodes[i].vpn, nodes[i].timestamp));
     }
+  }
 
-    page_table[vpn] = --lru_queue.end();
+  void load_state(CheckpointReader& in) override {
+    VmSimulator::load_state(in);
+    reset_frames();
+    page_table.clear();
+    uint64_t size = in.read<uint64_t>();
+    for (uint64_t i = 0; i < size && i < num_frames && in.good(); i++) {
+      PageFrame page = in.read<PageFrame>();
+      uint32_t frame = free_head;
+      free_head = nodes[frame].next;
+      nodes[frame].vpn = page.vpn;
+      nodes[frame].timestamp = page.timestamp;
+      link_back(frame);
+      page_table.insert_or_assign(page.vpn, frame);
+    }
   }
 
   virtual void print_info(std::ostream& os = std::cout) override {
@@ -56,8 +103,44 @@ public:
   }
 
 private:
-  std::list<PageFrame> lru_queue;
-  std::unordered_map<uint64_t, decltype(lru_queue)::iterator> page_table;
+  static constexpr uint32_t NIL = UINT32_MAX;
+
+  struct LruNode {
+    uint64_t vpn;
+    uint64_t timestamp;
+    uint32_t prev;
+    uint32_t next;
+  };
+
+  // the node after the frames, its next is the least and its prev the most recently used frame
+  uint32_t sentinel() const { return num_frames; }
+
+  // Empties the list and puts every frame on the free list, in frame order.
+  void reset_frames() {
+    nodes.assign(num_frames + 1, LruNode {0, FREE_TIMESTAMP, NIL, NIL});
+    nodes[sentinel()].prev = nodes[sentinel()].next = sentinel();
+    for (uint32_t i = 0; i < num_frames; i++) {
+      nodes[i].next = i + 1 < num_frames ? i + 1 : NIL;
+    }
+    free_head = num_frames > 0 ? 0 : NIL;
+  }
+
+  void unlink(uint32_t frame) {
+    nodes[nodes[frame].prev].next = nodes[frame].next;
+    nodes[nodes[frame].next].prev = nodes[frame].prev;
+  }
+
+  void link_back(uint32_t frame) {
+    uint32_t tail = nodes[sentinel()].prev;
+    nodes[frame].prev = tail;
+    nodes[frame].next = sentinel();
+    nodes[tail].next = frame;
+    nodes[sentinel()].prev = frame;
+  }
+
   uint64_t num_frames;
-  uint64_t time_tick {0};
+  std::vector<LruNode> nodes;
+  uint32_t free_head {NIL};
+  // map VPN to its frame
+  FlatPageTable<uint32_t> page_table;
 };
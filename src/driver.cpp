@@ -1,16 +1,89 @@
+#include <algorithm>
+#include <chrono>
 #include <getopt.h>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <string>
 #include <unordered_set>
+#include <vector>
 
 #include "iceberg_simulator.h"
 #include "universal_hashing_simulator.h"
+#include "checkpoint.h"
 #include "conventional_vm_simulator.h"
+#include "range_reduce.h"
+#include "sampled_simulator.h"
+#include "trace_interleaver.h"
+#include "trace_prefetcher.h"
+#include "trace_index.h"
+#include "trace_reader.h"
 #include "vm_simulator.h"
 #include "vm_stats.h"
+#include "worker_pool.h"
+
+// One simulator configuration given on the command line.
+struct SimConfig {
+  std::string sim_option = "";
+  double mem_size_mb = 4096;
+  int way_count = 128;
+  int fyard_size = 56;
+  int byard_size = 8;
+  // hash-space sampling, 0 disables it
+  double sample_fraction = 0;
+  // configs that only differ in the seed (1, 2, ...) form one sampled estimate
+  int sample_seed = 0;
+  // counting of distinct pages, see FootprintTracker
+  std::string footprint = "exact";
+  // universal hashing frame placement: bank (bank-major) or index (index-major)
+  std::string frame_layout = "bank";
+  // reduction of hashes to frame indices and yards, see RangeReducer
+  std::string range_reduction = "fast";
+  // hash family of the universal hashing and iceberg simulators, see hash_family::Family
+  std::string hash_family = "xxh64";
+
+  std::string describe() const;
+};
+
+// Accesses and page faults of one trace on one simulator.
+struct TraceCounters {
+  uint64_t accesses {0};
+  uint64_t page_faults {0};
+};
+
+// Position inside the page runs of a batch: run index and accesses of that run already taken.
+struct RunCursor {
+  size_t run;
+  uint32_t offset;
+};
 
 static void print_err_usage(const std::string& hint);
+static RunCursor advance_runs(const std::vector<PageRun>& runs, RunCursor cur, uint64_t len);
+static void simulate_runs(VmSimulator& simulator, const std::vector<PageRun>& runs,
+                          RunCursor begin, RunCursor end, std::vector<TraceCounters>& counters);
+static std::unique_ptr<VmSimulator> make_simulator(const SimConfig& config);
+static bool has_frames(const SimConfig& config);
+static void print_stats(const std::vector<std::unique_ptr<VmSimulator>>& simulators,
+                        const std::vector<SimConfig>& configs,
+                        const std::vector<std::vector<TraceCounters>>& trace_counters);
+static void print_trace_stats(const std::vector<std::vector<TraceCounters>>& trace_counters,
+                              const std::vector<SimConfig>& configs, size_t first, size_t n);
+static void save_checkpoint(const std::string& path, uint64_t access_cnt,
+                            const TraceInterleaver& interleaver,
+                            const std::vector<std::unique_ptr<VmSimulator>>& simulators,
+                            const std::vector<SimConfig>& configs,
+                            const std::vector<std::vector<TraceCounters>>& trace_counters);
+static uint64_t load_checkpoint(FILE *file, const TraceInterleaver& interleaver,
+                                const std::vector<std::unique_ptr<VmSimulator>>& simulators,
+                                const std::vector<SimConfig>& configs,
+                                std::vector<std::vector<TraceCounters>>& trace_counters);
+
+// number of records decoded from the trace at a time
+constexpr size_t TRACE_BATCH_SIZE = 1 << 16;
+// print statistics every X accesses
+constexpr uint64_t STATS_INTERVAL = 1000000;
+
+constexpr char CHECKPOINT_MAGIC[8] = {'T', 'L', 'B', 'C', 'K', 'P', 'T', '2'};
 
 static std::unordered_set<std::string> sim_options {
   "ice", "con", "uni-static", "uni-dyn", "uni-dyn-ind", "uni-dyn-tbl", "uni-dyn-xor"
@@ -18,51 +91,124 @@ static std::unordered_set<std::string> sim_options {
 
 int main(int argc, char *argv[]) {
 
-  FILE *trace = nullptr;
-  std::string sim_option = "";
+  std::vector<std::string> trace_paths;
+  uint64_t quantum = 1;
+  std::vector<uint64_t> trace_weights;
+  std::string checkpoint_path = "";
+  std::string index_path = "";
+  uint64_t checkpoint_interval = 100000000;
+  double sample_fraction = 0;
+  int sample_seeds = 5;
   int opt;
 
-  double mem_size_mb = 4096;
-  int way_count = 128;
-  int fyard_size = 56;
-  int byard_size = 8;
+  // -m/-w/-f/-b/-F/-L/-R/-H given before the first -s apply to every config,
+  // after that they apply to the most recent -s.
+  SimConfig default_config;
+  std::vector<SimConfig> configs;
+  auto current_config = [&]() -> SimConfig& {
+    return configs.empty() ? default_config : configs.back();
+  };
 
-  // t: path to the trace file
+  // t: path to the trace file, reads from stdin if omitted.
+  //    Binary, text and compact (see tlbsim-convert) traces are told apart automatically.
+  //    May be repeated to interleave several traces, each one in its own address space.
+  // q: interleaving quantum, number of consecutive records taken from a trace per turn
+  // r: comma-separated interleaving weights of the traces, a turn takes quantum * weight records
   // s: simulator type, options are:
   //        ice: iceberg
   //        con: conventional
   //        uni-static: universal (static set-associative)
   //        uni-dyn: universal (dynamic set-associative)
   //        uni-dyn-ind: universal (dynamic independent set-associative)
-  //        
+  //    May be repeated to simulate several configs in a single pass over the trace.
   // m: memory size in mb, can be a decimal
   // w: for universal hashing: number of ways(banks)
   // f: for iceberg hashing: frontyard size
   // b: for iceberg hashing: backyard size
-  while (-1 != (opt = getopt(argc, argv, "t:s:m:w:f:b:"))) {
+  // c: checkpoint file, the run resumes from it if it exists
+  // C: checkpoint every X accesses
+  // x: trace index file, <trace>.idx by default (single trace only)
+  // S: simulate only this fraction of the pages (hash-space sampling), scaling memory to match
+  // K: number of independent sample seeds used for the confidence interval
+  // F: how distinct pages (total page access) are counted: exact, hll (estimate) or off
+  // L: for universal hashing: frame placement, bank (bank after bank) or index (interleaved)
+  // R: reduction of hashes to frame indices and yards: fast (multiply-shift) or mod (modulo,
+  //    reproduces results from before multiply-shift)
+  // H: hash family of universal hashing and iceberg: xxh64, xxh3, murmur, mulshift or tab
+  while (-1 != (opt = getopt(argc, argv, "t:q:r:s:m:w:f:b:c:C:x:S:K:F:L:R:H:"))) {
     switch (opt) {
       case 't':
-        trace = std::fopen(optarg, "rb");
+        trace_paths.push_back(std::string(optarg));
+        break;
+
+      case 'q':
+        quantum = std::strtoull(optarg, nullptr, 10);
+        break;
+
+      case 'r': {
+        std::istringstream weights(optarg);
+        std::string weight;
+        while (std::getline(weights, weight, ',')) {
+          trace_weights.push_back(std::strtoull(weight.c_str(), nullptr, 10));
+        }
         break;
+      }
 
       case 's':
-        sim_option = std::string(optarg);
+        configs.push_back(default_config);
+        configs.back().sim_option = std::string(optarg);
         break;
 
       case 'm':
-        mem_size_mb = std::atof(optarg);
+        current_config().mem_size_mb = std::atof(optarg);
         break;
 
       case 'w':
-        way_count = std::atoi(optarg);
+        current_config().way_count = std::atoi(optarg);
         break;
       
       case 'f':
-        fyard_size = std::atoi(optarg);
+        current_config().fyard_size = std::atoi(optarg);
         break;
 
       case 'b':
-        byard_size = std::atoi(optarg);
+        current_config().byard_size = std::atoi(optarg);
+        break;
+
+      case 'c':
+        checkpoint_path = std::string(optarg);
+        break;
+
+      case 'C':
+        checkpoint_interval = std::strtoull(optarg, nullptr, 10);
+        break;
+
+      case 'x':
+        index_path = std::string(optarg);
+        break;
+
+      case 'S':
+        sample_fraction = std::atof(optarg);
+        break;
+
+      case 'K':
+        sample_seeds = std::atoi(optarg);
+        break;
+
+      case 'F':
+        current_config().footprint = std::string(optarg);
+        break;
+
+      case 'L':
+        current_config().frame_layout = std::string(optarg);
+        break;
+
+      case 'R':
+        current_config().range_reduction = std::string(optarg);
+        break;
+
+      case 'H':
+        current_config().hash_family = std::string(optarg);
         break;
 
       default:
@@ -71,53 +217,435 @@ int main(int argc, char *argv[]) {
     }
   }
 
-  std::unique_ptr<VmSimulator> simulator;
+  if (configs.empty()) {
+    print_err_usage("Invalid simulator option");
+  }
+
+  if (sample_fraction != 0) {
+    if (sample_fraction < 0 || sample_fraction > 1 || sample_seeds < 1) {
+      print_err_usage("Invalid sampling option");
+    }
+    std::vector<SimConfig> sampled_configs;
+    for (auto& config : configs) {
+      for (int seed = 1; seed <= sample_seeds; seed++) {
+        sampled_configs.push_back(config);
+        sampled_configs.back().sample_fraction = sample_fraction;
+        sampled_configs.back().sample_seed = seed;
+      }
+    }
+    configs = sampled_configs;
+  }
+
+  std::vector<std::unique_ptr<VmSimulator>> simulators;
+  for (auto& config : configs) {
+    simulators.push_back(make_simulator(config));
+  }
+
+  if (trace_paths.empty()) {
+    trace_paths.push_back("");
+  }
+  if (trace_paths.size() > TraceInterleaver::MAX_INPUTS) {
+    print_err_usage("Too many traces");
+  }
+  if (trace_weights.empty()) {
+    trace_weights.resize(trace_paths.size(), 1);
+  }
+  if (trace_weights.size() != trace_paths.size() || quantum == 0 ||
+      std::count(trace_weights.begin(), trace_weights.end(), 0) > 0) {
+    print_err_usage("Invalid interleaving option");
+  }
+
+  std::vector<std::unique_ptr<TraceReader>> readers;
+  std::vector<TraceReader *> reader_ptrs;
+  std::vector<uint64_t> turns;
+  for (size_t i = 0; i < trace_paths.size(); i++) {
+    readers.push_back(std::make_unique<TraceReader>());
+    if (!readers.back()->open(trace_paths[i])) {
+      print_err_usage("Could not open the input trace file " + trace_paths[i]);
+    }
+    reader_ptrs.push_back(readers.back().get());
+    turns.push_back(quantum * trace_weights[i]);
+  }
+  TraceInterleaver interleaver(reader_ptrs, turns);
+
+  uint64_t access_cnt = 0;
+  // accesses and page faults of every trace, by simulator
+  std::vector<std::vector<TraceCounters>> trace_counters(
+      simulators.size(), std::vector<TraceCounters>(trace_paths.size()));
+
+  std::vector<std::unique_ptr<TraceIndex>> indexes;
+  std::vector<std::string> index_paths;
+  if (!checkpoint_path.empty()) {
+    if (checkpoint_interval == 0) {
+      print_err_usage("Checkpoint interval should be positive");
+    }
+    if (!index_path.empty() && trace_paths.size() > 1) {
+      print_err_usage("An index file can only be given for a single trace");
+    }
+    for (size_t i = 0; i < trace_paths.size(); i++) {
+      if (readers[i]->file_size() == 0) {
+        print_err_usage("Checkpointing needs regular trace files");
+      }
+      index_paths.push_back(index_path.empty() ? trace_paths[i] + ".idx" : index_path);
+      indexes.push_back(std::make_unique<TraceIndex>());
+      indexes.back()->load(index_paths.back(), readers[i]->file_size());
+      readers[i]->set_index(indexes.back().get());
+    }
+
+    if (FILE *file = std::fopen(checkpoint_path.c_str(), "rb")) {
+      access_cnt = load_checkpoint(file, interleaver, simulators, configs, trace_counters);
+      std::fclose(file);
+      std::vector<uint64_t> positions;
+      for (auto& counters : trace_counters[0]) {
+        positions.push_back(counters.accesses);
+      }
+      if (!interleaver.seek(positions)) {
+        fprintf(stderr, "The trace ends before the checkpoint\n");
+        exit(EXIT_FAILURE);
+      }
+      fprintf(stderr, "resumed from %s at access %lu\n", checkpoint_path.c_str(), access_cnt);
+    }
+  }
+
+  uint64_t start_cnt = access_cnt;
+  auto start_time = std::chrono::steady_clock::now();
 
+  /* Begin reading the file, decoding runs ahead on the prefetcher's thread */
+  {
+    // every simulator has its own worker and sees every record of a batch
+    WorkerPool workers(simulators.size());
+    TracePrefetcher prefetcher(interleaver, TRACE_BATCH_SIZE);
+
+    while (TraceBatch *batch = prefetcher.next()) {
+      // split the batch at statistics and checkpoint boundaries, cutting runs if needed
+      RunCursor begin {0, 0};
+      for (size_t pos = 0; pos < batch->size;) {
+        size_t len = std::min<uint64_t>(batch->size - pos,
+                                        STATS_INTERVAL - access_cnt % STATS_INTERVAL);
+        if (!checkpoint_path.empty()) {
+          len = std::min<uint64_t>(len, checkpoint_interval - access_cnt % checkpoint_interval);
+        }
+        RunCursor end = advance_runs(batch->runs, begin, len);
+
+        workers.run([&](size_t i) {
+          simulate_runs(*simulators[i], batch->runs, begin, end, trace_counters[i]);
+        });
+
+        begin = end;
+        pos += len;
+        access_cnt += len;
+        if (access_cnt % STATS_INTERVAL == 0) {
+          print_stats(simulators, configs, trace_counters);
+        }
+        if (!checkpoint_path.empty() && access_cnt % checkpoint_interval == 0) {
+          save_checkpoint(checkpoint_path, access_cnt, interleaver, simulators, configs,
+                          trace_counters);
+          for (size_t i = 0; i < indexes.size(); i++) {
+            indexes[i]->save(index_paths[i], readers[i]->file_size());
+          }
+        }
+      }
+      prefetcher.release(batch);
+    }
+  }
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+  uint64_t simulated_cnt = access_cnt - start_cnt;
+  fprintf(stderr, "simulated %lu accesses in %.3lf s (%.0lf accesses/sec)\n", simulated_cnt,
+          elapsed.count(), elapsed.count() > 0 ? simulated_cnt / elapsed.count() : 0.0);
+  if (interleaver.malformed_records() > 0) {
+    fprintf(stderr, "skipped %lu malformed trace lines\n", interleaver.malformed_records());
+  }
+
+  print_stats(simulators, configs, trace_counters);
+}
+
+static RunCursor advance_runs(const std::vector<PageRun>& runs, RunCursor cur, uint64_t len) {
+  while (len > 0) {
+    uint32_t left = runs[cur.run].count - cur.offset;
+    if (len < left) {
+      cur.offset += len;
+      break;
+    }
+    len -= left;
+    cur = {cur.run + 1, 0};
+  }
+  return cur;
+}
+
+// Simulates the accesses between two cursors. Whole runs of the same trace go to the
+// simulator in one access_runs() call, runs cut by a cursor one at a time.
+// Page faults are charged to a trace by sampling the fault count whenever the trace changes.
+static void simulate_runs(VmSimulator& simulator, const std::vector<PageRun>& runs,
+                          RunCursor begin, RunCursor end, std::vector<TraceCounters>& counters) {
+  uint8_t asid = 0;
+  uint64_t faults = simulator.get_page_faults();
+  for (RunCursor cur = begin;
+       cur.run < end.run || (cur.run == end.run && cur.offset < end.offset);) {
+    const PageRun& run = runs[cur.run];
+    if (run.asid != asid) {
+      uint64_t now = simulator.get_page_faults();
+      counters[asid].page_faults += now - faults;
+      faults = now;
+      asid = run.asid;
+    }
+
+    if (cur.offset != 0 || cur.run == end.run) {
+      uint32_t stop = cur.run == end.run ? end.offset : run.count;
+      counters[asid].accesses += stop - cur.offset;
+      simulator.access_run(run.vpn, stop - cur.offset, run.rw_mask);
+      cur = {cur.run + 1, 0};
+      continue;
+    }
+
+    size_t last = cur.run;
+    uint64_t accesses = 0;
+    for (; last < end.run && runs[last].asid == asid; last++) {
+      accesses += runs[last].count;
+    }
+    counters[asid].accesses += accesses;
+    simulator.access_runs(&runs[cur.run], last - cur.run);
+    cur = {last, 0};
+  }
+  counters[asid].page_faults += simulator.get_page_faults() - faults;
+}
+
+std::string SimConfig::describe() const {
+  std::ostringstream desc;
+  desc << "-s " << sim_option << " -m " << mem_size_mb;
   if (sim_option == "ice") {
-    simulator = std::make_unique<IcebergSimulator>(mem_size_mb, fyard_size, byard_size);
+    desc << " -f " << fyard_size << " -b " << byard_size;
   }
-  else if (sim_option == "con") {
-    simulator = std::make_unique<ConventionalVmSimulator>(mem_size_mb);
+  else if (sim_option != "con") {
+    desc << " -w " << way_count;
+    if (frame_layout != "bank") {
+      desc << " -L " << frame_layout;
+    }
+  }
+  if (sim_option != "con" && range_reduction != "fast") {
+    desc << " -R " << range_reduction;
+  }
+  if (sim_option != "con" && hash_family != "xxh64") {
+    desc << " -H " << hash_family;
+  }
+  if (sample_fraction != 0) {
+    desc << " -S " << sample_fraction;
+  }
+  if (footprint != "exact") {
+    desc << " -F " << footprint;
+  }
+  return desc.str();
+}
+
+static std::unique_ptr<VmSimulator> make_simulator(const SimConfig& config) {
+  if (config.sample_fraction != 0) {
+    SimConfig scaled = config;
+    scaled.mem_size_mb *= config.sample_fraction;
+    scaled.sample_fraction = 0;
+    if (!has_frames(scaled)) {
+      print_err_usage("Memory scaled by -S is too small for the simulator, raise -m or -S");
+    }
+    return std::make_unique<SampledSimulator>(make_simulator(scaled), config.sample_fraction,
+                                              config.sample_seed);
   }
-  else if (sim_options.count(sim_option) == 1) {
-    simulator = std::make_unique<UniversalHashingSimulator>(mem_size_mb, way_count, sim_option);
+
+  FootprintTracker::Mode footprint_mode;
+  if (!FootprintTracker::parse_mode(config.footprint, footprint_mode)) {
+    print_err_usage("Invalid footprint option");
+  }
+
+  RangeReducer::Method reduction;
+  if (!RangeReducer::parse_method(config.range_reduction, reduction)) {
+    print_err_usage("Invalid range reduction option");
+  }
+  hash_family::Family family;
+  if (!hash_family::parse(config.hash_family, family)) {
+    print_err_usage("Invalid hash family option");
+  }
+
+  if (!has_frames(config)) {
+    print_err_usage("Memory is too small for the simulator, raise -m");
+  }
+
+  std::unique_ptr<VmSimulator> simulator;
+  if (config.sim_option == "ice") {
+    simulator = std::make_unique<IcebergSimulator>(config.mem_size_mb, config.fyard_size,
+                                                   config.byard_size, reduction, family);
+  }
+  else if (config.sim_option == "con") {
+    simulator = std::make_unique<ConventionalVmSimulator>(config.mem_size_mb);
+  }
+  else if (sim_options.count(config.sim_option) == 1) {
+    using FrameLayout = UniversalHashingSimulator::FrameLayout;
+    if (config.frame_layout != "bank" && config.frame_layout != "index") {
+      print_err_usage("Invalid frame layout option");
+    }
+    FrameLayout layout =
+        config.frame_layout == "bank" ? FrameLayout::BANK_MAJOR : FrameLayout::INDEX_MAJOR;
+    simulator = std::make_unique<UniversalHashingSimulator>(config.mem_size_mb, config.way_count,
+                                                            config.sim_option, layout, reduction,
+                                                            family);
   }
   else {
     print_err_usage("Invalid simulator option");
   }
+  simulator->set_footprint_mode(footprint_mode);
+  return simulator;
+}
+
+// Whether the simulator of `config` gets at least one yard (ice), one frame per bank (uni-*) or
+// one frame (con), computed the way the simulators size themselves.
+static bool has_frames(const SimConfig& config) {
+  double frames = config.mem_size_mb * 1024 / PAGE_SIZE_KB;
+  if (config.sim_option == "ice") {
+    int yard_size = config.fyard_size + config.byard_size;
+    return yard_size > 0 && (size_t)(frames / yard_size) >= 1;
+  }
+  if (config.sim_option == "con") {
+    return (size_t)frames >= 1;
+  }
+  return config.way_count > 0 && (size_t)(frames / config.way_count) >= 1;
+}
+
+// With several configs, each block of statistics is preceded by the config it belongs to.
+// Sampled configs are reported as one estimate over all their seeds.
+static void print_stats(const std::vector<std::unique_ptr<VmSimulator>>& simulators,
+                        const std::vector<SimConfig>& configs,
+                        const std::vector<std::vector<TraceCounters>>& trace_counters) {
+  size_t group_count = std::count_if(configs.begin(), configs.end(),
+                                     [](auto& config) { return config.sample_seed <= 1; });
 
-  if (trace == nullptr) {
-    if (feof(stdin)) {
-      print_err_usage("Could not open the input trace file");
+  for (size_t i = 0, group = 1; i < simulators.size(); group++) {
+    size_t n = 1;
+    while (i + n < configs.size() && configs[i + n].sample_seed > 1) {
+      n++;
+    }
+
+    if (group_count > 1) {
+      printf("# config %zu (%s)\n", group, configs[i].describe().c_str());
+    }
+    if (configs[i].sample_fraction != 0) {
+      std::vector<vm_stats> seeds;
+      for (size_t j = i; j < i + n; j++) {
+        seeds.push_back(simulators[j]->get_stats());
+      }
+      print_sampled_stats(seeds);
     }
     else {
-      trace = fdopen(fileno(stdin), "rb");
+      simulators[i]->get_stats().print();
     }
+    if (trace_counters[i].size() > 1) {
+      print_trace_stats(trace_counters, configs, i, n);
+    }
+    i += n;
   }
+}
 
-  char rw;
-  uint64_t address;
-  uint64_t access_cnt = 0;
+// Accesses and page faults of every interleaved trace, for the configs [first, first + n).
+static void print_trace_stats(const std::vector<std::vector<TraceCounters>>& trace_counters,
+                              const std::vector<SimConfig>& configs, size_t first, size_t n) {
+  for (size_t t = 0; t < trace_counters[first].size(); t++) {
+    printf("trace %zu accesses: %lu\n", t + 1, trace_counters[first][t].accesses);
+    if (configs[first].sample_fraction != 0) {
+      std::vector<double> faults;
+      for (size_t j = first; j < first + n; j++) {
+        faults.push_back(trace_counters[j][t].page_faults / configs[j].sample_fraction);
+      }
+      auto estimate = SampledValue::of(faults);
+      printf("trace %zu page faults: %.0lf +- %.0lf\n", t + 1, estimate.mean,
+             estimate.half_width);
+    }
+    else {
+      printf("trace %zu page faults: %lu\n", t + 1, trace_counters[first][t].page_faults);
+    }
+  }
+  printf("\n");
+}
 
-  /* Begin reading the file */
-  while (!feof(trace)
-          && fread(&rw, sizeof(char), 1, trace) == 1
-          && fread(&address, sizeof(uint64_t), 1, trace) == 1) {
-    
-    simulator->access(address, rw);
+// Checkpoint layout: magic, access count, trace sizes and turns, config descriptions, simulator
+// states, per-trace counters. It is written to a temporary file first, so a preempted run never
+// leaves a partial checkpoint.
+static void save_checkpoint(const std::string& path, uint64_t access_cnt,
+                            const TraceInterleaver& interleaver,
+                            const std::vector<std::unique_ptr<VmSimulator>>& simulators,
+                            const std::vector<SimConfig>& configs,
+                            const std::vector<std::vector<TraceCounters>>& trace_counters) {
+  std::string tmp_path = path + ".tmp";
+  FILE *file = std::fopen(tmp_path.c_str(), "wb");
+  if (file == nullptr) {
+    fprintf(stderr, "Could not write checkpoint %s\n", tmp_path.c_str());
+    return;
+  }
 
-    access_cnt += 1;
-    if (access_cnt % 1000000 == 0) {
-      simulator->get_stats().print();
-    }
+  CheckpointWriter out(file);
+  out.write_bytes(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+  out.write(access_cnt);
+  out.write<uint64_t>(interleaver.size());
+  for (size_t i = 0; i < interleaver.size(); i++) {
+    out.write(interleaver.reader(i).file_size());
+    out.write(interleaver.get_turn(i));
+  }
+  out.write<uint64_t>(configs.size());
+  for (auto& config : configs) {
+    out.write_string(config.describe());
+  }
+  for (auto& simulator : simulators) {
+    simulator->save_state(out);
+  }
+  for (auto& counters : trace_counters) {
+    out.write_vector(counters);
   }
 
-  simulator->get_stats().print();
+  bool ok = std::fclose(file) == 0 && out.good();
+  if (!ok || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    fprintf(stderr, "Could not write checkpoint %s\n", path.c_str());
+  }
+}
+
+// Restores the simulators and per-trace counters, returns the number of accesses already
+// simulated.
+static uint64_t load_checkpoint(FILE *file, const TraceInterleaver& interleaver,
+                                const std::vector<std::unique_ptr<VmSimulator>>& simulators,
+                                const std::vector<SimConfig>& configs,
+                                std::vector<std::vector<TraceCounters>>& trace_counters) {
+  CheckpointReader in(file);
+  char magic[sizeof(CHECKPOINT_MAGIC)];
+  in.read_bytes(magic, sizeof(magic));
+  uint64_t access_cnt = in.read<uint64_t>();
+  bool ok = in.good() && std::equal(magic, magic + sizeof(magic), CHECKPOINT_MAGIC) &&
+            in.read<uint64_t>() == interleaver.size();
+  for (size_t i = 0; ok && i < interleaver.size(); i++) {
+    ok = in.read<uint64_t>() == interleaver.reader(i).file_size() &&
+         in.read<uint64_t>() == interleaver.get_turn(i);
+  }
+  ok = ok && in.read<uint64_t>() == configs.size();
+  for (size_t i = 0; ok && i < configs.size(); i++) {
+    ok = in.read_string() == configs[i].describe();
+  }
+  if (!ok) {
+    fprintf(stderr, "The checkpoint does not match this trace and these configs\n");
+    exit(EXIT_FAILURE);
+  }
+
+  for (auto& simulator : simulators) {
+    simulator->load_state(in);
+  }
+  for (auto& counters : trace_counters) {
+    in.read_vector(counters);
+    ok = ok && counters.size() == interleaver.size();
+  }
+  if (!in.good() || !ok) {
+    fprintf(stderr, "The checkpoint is truncated\n");
+    exit(EXIT_FAILURE);
+  }
+  return access_cnt;
 }
 
 static void print_err_usage(const std::string& hint) {
   std::cout << hint << '\n';
   std::cout << "usage:\n";
-  std::cout << "./tlbsim -t <path-to-trace-file> -s <simulator, i or u >\n";
+  std::cout << "./tlbsim -t <path-to-trace-file> [-t <path-to-trace-file> ...] [-q <quantum>] "
+               "[-r <weight>,...] -s <simulator> [-m <mb>] [-w <ways>] [-f <fyard>] "
+               "[-b <byard>] [-s <simulator> ...]\n";
   exit(EXIT_FAILURE);
 }
\ No newline at end of file
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "checkpoint.h"
+
+// Page table mapping VPNs to a frame reference of type V, stored in one flat array with
+// linear probing. Deletion shifts the following entries of the cluster back instead of leaving
+// tombstones, so lookups never slow down as pages come and go.
+//
+// Sized from the number of frames, which bounds the number of mapped pages, so the load
+// factor stays at or below one half and the table never grows in practice.
+template <typename V>
+class FlatPageTable {
+public:
+  // VPNs, even with an address space ID above them, never reach this value
+  static constexpr uint64_t EMPTY = UINT64_MAX;
+
+  explicit FlatPageTable(size_t max_pages = 0) {
+    size_t capacity = 16;
+    while (capacity < 2 * max_pages) {
+      capacity *= 2;
+    }
+    allocate(capacity);
+  }
+
+  size_t size() const { return count; }
+
+  // Returns the value mapped to `vpn`, nullptr if there is none.
+  V *find(uint64_t vpn) {
+    for (size_t i = home(vpn);; i = (i + 1) & mask) {
+      if (slots[i].vpn == vpn) return &slots[i].value;
+      if (slots[i].vpn == EMPTY) return nullptr;
+    }
+  }
+
+  // Pulls the home slot of `vpn` into the cache ahead of a find().
+  void prefetch(uint64_t vpn) const {
+    __builtin_prefetch(&slots[home(vpn)]);
+  }
+
+  void insert_or_assign(uint64_t vpn, const V& value) {
+    size_t i = home(vpn);
+    for (; slots[i].vpn != EMPTY; i = (i + 1) & mask) {
+      if (slots[i].vpn == vpn) {
+        slots[i].value = value;
+        return;
+      }
+    }
+    slots[i] = {vpn, value};
+    if (++count * 2 > slots.size()) {
+      allocate(slots.size() * 2);
+    }
+  }
+
+  void erase(uint64_t vpn) {
+    size_t hole = home(vpn);
+    for (; slots[hole].vpn != vpn; hole = (hole + 1) & mask) {
+      if (slots[hole].vpn == EMPTY) return;
+    }
+    count--;
+
+    // pull back every later entry of the cluster whose probe sequence passes the hole
+    for (size_t i = (hole + 1) & mask; slots[i].vpn != EMPTY; i = (i + 1) & mask) {
+      if (((i - home(slots[i].vpn)) & mask) >= ((i - hole) & mask)) {
+        slots[hole] = slots[i];
+        hole = i;
+      }
+    }
+    slots[hole].vpn = EMPTY;
+  }
+
+  void clear() {
+    for (auto& slot : slots) {
+      slot.vpn = EMPTY;
+    }
+    count = 0;
+  }
+
+  // The entry count, then every (vpn, value) pair in slot order.
+  void save(CheckpointWriter& out) const {
+    out.write<uint64_t>(count);
+    for (auto& slot : slots) {
+      if (slot.vpn != EMPTY) {
+        out.write(slot.vpn);
+        out.write(slot.value);
+      }
+    }
+  }
+
+  void load(CheckpointReader& in) {
+    clear();
+    uint64_t size = in.read<uint64_t>();
+    for (uint64_t i = 0; i < size && in.good(); i++) {
+      uint64_t vpn = in.read<uint64_t>();
+      insert_or_assign(vpn, in.read<V>());
+    }
+  }
+
+private:
+  struct Slot {
+    uint64_t vpn;
+    V value;
+  };
+
+  // Fibonacci hashing, the top bits of the product are well mixed even for sequential VPNs
+  size_t home(uint64_t vpn) const {
+    return (vpn * 0x9e3779b97f4a7c15ULL) >> shift;
+  }
+
+  void allocate(size_t capacity) {
+    std::vector<Slot> old(capacity, Slot {EMPTY, V {}});
+    old.swap(slots);
+    mask = capacity - 1;
+    shift = 64 - __builtin_ctzll(capacity);
+    count = 0;
+    for (auto& slot : old) {
+      if (slot.vpn != EMPTY) {
+        insert_or_assign(slot.vpn, slot.value);
+      }
+    }
+  }
+
+  std::vector<Slot> slots;
+  size_t mask {0};
+  int shift {0};
+  size_t count {0};
+};
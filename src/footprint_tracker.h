@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "checkpoint.h"
+#include "flat_page_table.h"
+
+// Counts the distinct pages a simulator has seen, reported as "total page access".
+//   EXACT: a bitmap per 2MB region of the address space, regions found through a flat table
+//          keyed on the high VPN bits. Dense footprints cost about one bit per page.
+//   HLL:   HyperLogLog estimate in 16KB, within about 1% of the exact count.
+//   OFF:   nothing is tracked and the count stays 0.
+class FootprintTracker {
+public:
+  enum class Mode {
+    EXACT,
+    HLL,
+    OFF
+  };
+
+  static bool parse_mode(const std::string& name, Mode& mode) {
+    if (name == "exact") mode = Mode::EXACT;
+    else if (name == "hll") mode = Mode::HLL;
+    else if (name == "off") mode = Mode::OFF;
+    else return false;
+    return true;
+  }
+
+  explicit FootprintTracker(Mode mode = Mode::EXACT) {
+    set_mode(mode);
+  }
+
+  // Switches to another mode, dropping whatever was tracked so far.
+  void set_mode(Mode new_mode) {
+    mode = new_mode;
+    leaf_index = FlatPageTable<uint32_t>();
+    leaves.clear();
+    leaf_regions.clear();
+    last_region = UINT64_MAX;
+    count = 0;
+    registers.assign(mode == Mode::HLL ? HLL_REGISTERS : 0, 0);
+  }
+
+  Mode get_mode() const { return mode; }
+
+  void insert(uint64_t vpn) {
+    switch (mode) {
+      case Mode::EXACT:
+        insert_exact(vpn);
+        break;
+      case Mode::HLL:
+        insert_hll(vpn);
+        break;
+      default:
+        break;
+    }
+  }
+
+  uint64_t size() const {
+    return mode == Mode::HLL ? estimate_hll() : count;
+  }
+
+  void save(CheckpointWriter& out) const {
+    out.write(count);
+    out.write_vector(leaf_regions);
+    out.write_vector(leaves);
+    out.write_vector(registers);
+  }
+
+  void load(CheckpointReader& in) {
+    set_mode(mode);
+    in.read(count);
+    in.read_vector(leaf_regions);
+    in.read_vector(leaves);
+    in.read_vector(registers);
+    for (size_t i = 0; i < leaf_regions.size(); i++) {
+      leaf_index.insert_or_assign(leaf_regions[i], i);
+    }
+  }
+
+private:
+  // one leaf covers 512 pages (2MB) and is one cache line of bits
+  static constexpr int LEAF_BITS = 9;
+  static constexpr int HLL_PRECISION = 14;
+  static constexpr size_t HLL_REGISTERS = 1 << HLL_PRECISION;
+
+  struct Leaf {
+    uint64_t words[(1 << LEAF_BITS) / 64];
+  };
+
+  void insert_exact(uint64_t vpn) {
+    uint64_t region = vpn >> LEAF_BITS;
+    if (region != last_region) {
+      uint32_t *idx = leaf_index.find(region);
+      if (idx == nullptr) {
+        leaf_index.insert_or_assign(region, leaves.size());
+        leaf_regions.push_back(region);
+        leaves.push_back({});
+        last_leaf = leaves.size() - 1;
+      }
+      else {
+        last_leaf = *idx;
+      }
+      last_region = region;
+    }
+
+    uint64_t bit = vpn & ((1 << LEAF_BITS) - 1);
+    uint64_t& word = leaves[last_leaf].words[bit / 64];
+    uint64_t flag = 1ULL << (bit % 64);
+    count += (word & flag) == 0;
+    word |= flag;
+  }
+
+  void insert_hll(uint64_t vpn) {
+    // splitmix64 finalizer
+    uint64_t h = vpn + 0x9e3779b97f4a7c15ULL;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+
+    size_t idx = h >> (64 - HLL_PRECISION);
+    // the guard bit caps the rank when the remaining bits are all zero
+    uint64_t rest = (h << HLL_PRECISION) | (1ULL << (HLL_PRECISION - 1));
+    uint8_t rank = __builtin_clzll(rest) + 1;
+    if (rank > registers[idx]) {
+      registers[idx] = rank;
+    }
+  }
+
+  uint64_t estimate_hll() const {
+    double m = HLL_REGISTERS;
+    double sum = 0;
+    size_t zeros = 0;
+    for (uint8_t r : registers) {
+      sum += std::ldexp(1.0, -r);
+      zeros += r == 0;
+    }
+    double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    if (estimate <= 2.5 * m && zeros != 0) {
+      // linear counting is more accurate for small counts
+      estimate = m * std::log(m / zeros);
+    }
+    return std::llround(estimate);
+  }
+
+  Mode mode {Mode::EXACT};
+
+  // exact mode
+  FlatPageTable<uint32_t> leaf_index;
+  std::vector<Leaf> leaves;
+  std::vector<uint64_t> leaf_regions;
+  uint64_t last_region {UINT64_MAX};
+  uint32_t last_leaf {0};
+  uint64_t count {0};
+
+  // HyperLogLog mode
+  std::vector<uint8_t> registers;
+};
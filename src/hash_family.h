@@ -0,0 +1,236 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "xxh64_lanes.h"
+
+#define XXH_STATIC_LINKING_ONLY // should keep this marco for xxhash
+#define XXH_IMPLEMENTATION      // should keep this marco for xxhash
+#include "include/xxhash.h"
+
+// Seeded 64-bit hashes of 64-bit keys (VPNs) that the universal hashing and iceberg
+// simulators can choose between. A policy is built for the seeds [0, seed_count) a simulator
+// uses, whatever depends on the seed alone is computed then, and it provides
+//   uint64_t hash(uint64_t key, size_t seed) const;
+//   void hash_seeds(uint64_t input, size_t n, uint64_t *out) const;   out[i] = hash(input, i)
+//   void hash_inputs(uint64_t input, size_t n, uint64_t *out) const;  out[i] = lane i of input
+// The simulators compile their loops per policy, see visit().
+//
+// XXH64's input lanes are hash(input ^ i, 0), as the simulators always computed them. The other
+// families use hash(input, i): input ^ i only flips low key bits, which a linear hash
+// (multiply-shift) or a per-byte one (tabulation) turns into nearly the same value on every
+// lane, so pages colliding in one bank would collide in many others.
+//
+// XXH64 is what the simulators always used and keeps its SIMD lane hashers, the others run
+// their lanes as scalar loops.
+namespace hash_family {
+
+enum class Family {
+  XXH64,
+  XXH3,
+  MURMUR,
+  MULTIPLY_SHIFT,
+  TABULATION
+};
+
+constexpr Family ALL_FAMILIES[] = {
+  Family::XXH64, Family::XXH3, Family::MURMUR, Family::MULTIPLY_SHIFT, Family::TABULATION
+};
+
+inline const char *name(Family family) {
+  switch (family) {
+    case Family::XXH3:
+      return "xxh3";
+    case Family::MURMUR:
+      return "murmur";
+    case Family::MULTIPLY_SHIFT:
+      return "mulshift";
+    case Family::TABULATION:
+      return "tab";
+    default:
+      return "xxh64";
+  }
+}
+
+inline bool parse(const std::string& str, Family& family) {
+  for (Family candidate : ALL_FAMILIES) {
+    if (str == name(candidate)) {
+      family = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+inline uint64_t splitmix64(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+// hash_seeds() and hash_inputs() as scalar loops over H::hash(), both with one seed per lane
+template <typename H>
+struct ScalarLanes {
+  void hash_seeds(uint64_t input, size_t n, uint64_t *out) const {
+    for (size_t i = 0; i < n; i++) {
+      out[i] = static_cast<const H&>(*this).hash(input, i);
+    }
+  }
+
+  void hash_inputs(uint64_t input, size_t n, uint64_t *out) const {
+    hash_seeds(input, n, out);
+  }
+};
+
+class Xxh64 {
+public:
+  explicit Xxh64(size_t seed_count = 0)
+      : seed_lanes(xxh64_lanes::select_seed_hasher()),
+        input_lanes(xxh64_lanes::select_input_hasher()) {}
+
+  uint64_t hash(uint64_t key, size_t seed) const {
+    return xxh64_lanes::hash8(key, seed);
+  }
+
+  void hash_seeds(uint64_t input, size_t n, uint64_t *out) const {
+    seed_lanes(input, n, out);
+  }
+
+  void hash_inputs(uint64_t input, size_t n, uint64_t *out) const {
+    input_lanes(input, n, out);
+  }
+
+private:
+  xxh64_lanes::LaneHasher seed_lanes;
+  xxh64_lanes::LaneHasher input_lanes;
+};
+
+struct Xxh3 : ScalarLanes<Xxh3> {
+  explicit Xxh3(size_t seed_count = 0) {}
+
+  uint64_t hash(uint64_t key, size_t seed) const {
+    return XXH3_64bits_withSeed(&key, sizeof(key), seed);
+  }
+};
+
+// MurmurHash3 64-bit finalizer, the seed is folded into the key first
+struct Murmur : ScalarLanes<Murmur> {
+  explicit Murmur(size_t seed_count = 0) {}
+
+  uint64_t hash(uint64_t key, size_t seed) const {
+    uint64_t h = key ^ (seed * 0x9e3779b97f4a7c15ULL);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+};
+
+// Multiply-add-shift: the high 64 bits of (a * key + b) mod 2^128, with 128-bit a and b drawn
+// per seed. Strongly universal, and every output bit depends on the whole key.
+class MultiplyShift : public ScalarLanes<MultiplyShift> {
+public:
+  explicit MultiplyShift(size_t seed_count = 0) : params(seed_count) {
+    for (size_t seed = 0; seed < seed_count; seed++) {
+      params[seed].a_lo = splitmix64(seed * 4) | 1;
+      params[seed].a_hi = splitmix64(seed * 4 + 1);
+      params[seed].b = (unsigned __int128)splitmix64(seed * 4 + 2) << 64 |
+                       splitmix64(seed * 4 + 3);
+    }
+  }
+
+  uint64_t hash(uint64_t key, size_t seed) const {
+    const Params& p = params[seed];
+    unsigned __int128 product = (unsigned __int128)p.a_lo * key +
+                                ((unsigned __int128)(p.a_hi * key) << 64);
+    return (product + p.b) >> 64;
+  }
+
+private:
+  struct Params {
+    uint64_t a_lo;
+    uint64_t a_hi;
+    unsigned __int128 b;
+  };
+
+  std::vector<Params> params;
+};
+
+// Simple tabulation over the 8 key bytes, the key is first xor'ed with a per-seed mask. The
+// tables (16KB) are filled from a fixed seed.
+class Tabulation : public ScalarLanes<Tabulation> {
+public:
+  explicit Tabulation(size_t seed_count = 0) : masks(seed_count) {
+    for (size_t seed = 0; seed < seed_count; seed++) {
+      masks[seed] = splitmix64(seed);
+    }
+    if (seed_count > 0) {
+      std::mt19937_64 generator(1u);
+      rows.resize(8 * 256);
+      for (auto& entry : rows) {
+        entry = generator();
+      }
+    }
+  }
+
+  uint64_t hash(uint64_t key, size_t seed) const {
+    key ^= masks[seed];
+    uint64_t h = 0;
+    for (int i = 0; i < 8; i++) {
+      h ^= rows[i * 256 + ((key >> (8 * i)) & 0xff)];
+    }
+    return h;
+  }
+
+private:
+  std::vector<uint64_t> masks;
+  std::vector<uint64_t> rows;
+};
+
+// One policy of every family. A simulator seeds only the one it uses and its loops, compiled
+// per family, pick it with std::get.
+using Policies = std::tuple<Xxh64, Xxh3, Murmur, MultiplyShift, Tabulation>;
+
+inline Policies make_policies(Family family, size_t seed_count) {
+  auto seeds = [&](Family f) { return f == family ? seed_count : 0; };
+  return Policies {Xxh64(seeds(Family::XXH64)), Xxh3(seeds(Family::XXH3)),
+                   Murmur(seeds(Family::MURMUR)), MultiplyShift(seeds(Family::MULTIPLY_SHIFT)),
+                   Tabulation(seeds(Family::TABULATION))};
+}
+
+template <typename H>
+struct Tag {
+  using type = H;
+};
+
+// Calls f(Tag<H>{}) with the policy type H of `family`.
+template <typename F>
+void visit(Family family, F&& f) {
+  switch (family) {
+    case Family::XXH3:
+      f(Tag<Xxh3> {});
+      break;
+    case Family::MURMUR:
+      f(Tag<Murmur> {});
+      break;
+    case Family::MULTIPLY_SHIFT:
+      f(Tag<MultiplyShift> {});
+      break;
+    case Family::TABULATION:
+      f(Tag<Tabulation> {});
+      break;
+    default:
+      f(Tag<Xxh64> {});
+      break;
+  }
+}
+
+}  // namespace hash_family
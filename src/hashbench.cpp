@@ -0,0 +1,236 @@
+#include <getopt.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "constants+helper.h"
+#include "hash_family.h"
+#include "iceberg_simulator.h"
+#include "range_reduce.h"
+#include "trace_reader.h"
+#include "universal_hashing_simulator.h"
+
+static void print_err_usage(const std::string& hint);
+
+constexpr size_t TRACE_BATCH_SIZE = 1 << 16;
+// scalar hashes timed per family
+constexpr uint64_t TIMED_HASHES = 1 << 24;
+// seeds the hashes are timed with
+constexpr size_t TIMED_SEEDS = 8;
+
+struct Trace {
+  std::string path;
+  std::vector<TraceRecord> records;
+  // distinct tagged page numbers
+  std::vector<uint64_t> pages;
+};
+
+struct Load {
+  double max_over_mean;
+  double stddev_over_mean;
+  // pages that do not fit the frontyard of their first-choice yard
+  uint64_t overflow;
+};
+
+static Trace load_trace(const std::string& path) {
+  TraceReader reader;
+  if (!reader.open(path)) {
+    print_err_usage("Could not open the trace file " + path);
+  }
+  Trace trace {path};
+  std::vector<TraceRecord> batch(TRACE_BATCH_SIZE);
+  size_t batch_len;
+  while ((batch_len = reader.read(batch.data(), batch.size())) > 0) {
+    trace.records.insert(trace.records.end(), batch.begin(), batch.begin() + batch_len);
+  }
+  for (auto& record : trace.records) {
+    trace.pages.push_back(get_tagged_page_number(record.addr, record.asid));
+  }
+  std::sort(trace.pages.begin(), trace.pages.end());
+  trace.pages.erase(std::unique(trace.pages.begin(), trace.pages.end()), trace.pages.end());
+  return trace;
+}
+
+// Spreads the pages over the yards the iceberg simulator would pick first for them.
+template <typename H>
+static Load yard_load(const std::vector<uint64_t>& pages, const H& hash,
+                      const RangeReducer& reduce, size_t yard_num, int fyard_size) {
+  std::vector<uint64_t> loads(yard_num, 0);
+  for (uint64_t page : pages) {
+    loads[reduce(hash.hash(page, 0))]++;
+  }
+  double mean = (double)pages.size() / yard_num;
+  double var = 0;
+  uint64_t overflow = 0;
+  for (uint64_t load : loads) {
+    var += (load - mean) * (load - mean);
+    overflow += load > (uint64_t)fyard_size ? load - fyard_size : 0;
+  }
+  uint64_t max_load = *std::max_element(loads.begin(), loads.end());
+  return {max_load / mean, std::sqrt(var / yard_num) / mean, overflow};
+}
+
+// Times the hash the way the simulators call it, inlined into the loop.
+template <typename H>
+static double hashes_per_second(const std::vector<uint64_t>& keys, const H& hash) {
+  uint64_t sink = 0;
+  uint64_t done = 0;
+  auto start = std::chrono::steady_clock::now();
+  while (done < TIMED_HASHES) {
+    size_t seed = (done / keys.size()) % TIMED_SEEDS;
+    for (uint64_t key : keys) {
+      sink += hash.hash(key, seed);
+    }
+    done += keys.size();
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  // keeps the hashes from being optimized away
+  asm volatile("" : : "r"(sink));
+  return done / elapsed.count();
+}
+
+template <typename Simulator, typename... Args>
+static uint64_t count_faults(const Trace& trace, Args&&... args) {
+  // the simulators print their configuration when built
+  std::ostringstream discard;
+  std::streambuf *old = std::cout.rdbuf(discard.rdbuf());
+  Simulator simulator(std::forward<Args>(args)...);
+  std::cout.rdbuf(old);
+  simulator.access_batch(trace.records.data(), trace.records.size());
+  return simulator.get_page_faults();
+}
+
+// Compares the hash families on the traces: how fast each hashes a page number, how evenly
+// it spreads the pages of a trace over the iceberg yards, and how many page faults the iceberg
+// and universal hashing (uni-dyn-ind and uni-dyn) simulators take with it.
+int main(int argc, char *argv[]) {
+
+  std::vector<std::string> trace_paths;
+  double mem_size_mb = 0.5;
+  int way_count = 8;
+  int fyard_size = 7;
+  int byard_size = 1;
+  std::string reduction_option = "fast";
+  int opt;
+
+  // t: path to a trace, can be repeated, defaults to every trace in short_traces/
+  // m: simulated memory size in MB, small so the short traces put pressure on it
+  // w: number of banks of the universal hashing simulator
+  // f/b: frontyard and backyard sizes of the iceberg simulator
+  // R: reduction of hashes to frame indices and yards, fast or mod
+  while (-1 != (opt = getopt(argc, argv, "t:m:w:f:b:R:"))) {
+    switch (opt) {
+      case 't':
+        trace_paths.push_back(std::string(optarg));
+        break;
+
+      case 'm':
+        mem_size_mb = std::atof(optarg);
+        break;
+
+      case 'w':
+        way_count = std::atoi(optarg);
+        break;
+
+      case 'f':
+        fyard_size = std::atoi(optarg);
+        break;
+
+      case 'b':
+        byard_size = std::atoi(optarg);
+        break;
+
+      case 'R':
+        reduction_option = std::string(optarg);
+        break;
+
+      default:
+        print_err_usage("Invalid argument to program");
+        break;
+    }
+  }
+
+  RangeReducer::Method reduction;
+  if (!RangeReducer::parse_method(reduction_option, reduction)) {
+    print_err_usage("Invalid range reduction option");
+  }
+  if (trace_paths.empty()) {
+    std::error_code ec;
+    for (auto& entry : std::filesystem::directory_iterator("short_traces", ec)) {
+      trace_paths.push_back(entry.path().string());
+    }
+    std::sort(trace_paths.begin(), trace_paths.end());
+  }
+  if (trace_paths.empty()) {
+    print_err_usage("No traces given and none found in short_traces/");
+  }
+
+  size_t yard_num = mem_size_mb * 1024 / PAGE_SIZE_KB / (fyard_size + byard_size);
+  if (yard_num == 0 || way_count <= 0 ||
+      mem_size_mb * 1024 / PAGE_SIZE_KB / way_count < 1) {
+    print_err_usage("Memory too small for the given yard or bank sizes");
+  }
+  RangeReducer yard_reduce(yard_num, reduction);
+
+  std::vector<Trace> traces;
+  std::vector<uint64_t> all_pages;
+  for (auto& path : trace_paths) {
+    traces.push_back(load_trace(path));
+    all_pages.insert(all_pages.end(), traces.back().pages.begin(), traces.back().pages.end());
+  }
+  if (all_pages.empty()) {
+    print_err_usage("The traces hold no records");
+  }
+
+  printf("memory: %g MB\n", mem_size_mb);
+  printf("yards: %lu (-f %d -b %d)\n", yard_num, fyard_size, byard_size);
+  printf("banks: %d\n", way_count);
+  printf("reduction: %s\n", yard_reduce.name());
+
+  for (auto family : hash_family::ALL_FAMILIES) {
+    printf("\nhash family: %s\n", hash_family::name(family));
+    hash_family::visit(family, [&](auto tag) {
+      using H = typename decltype(tag)::type;
+      printf("hashes per second: %.3e\n", hashes_per_second(all_pages, H(TIMED_SEEDS)));
+    });
+
+    for (auto& trace : traces) {
+      Load load;
+      hash_family::visit(family, [&](auto tag) {
+        using H = typename decltype(tag)::type;
+        load = yard_load(trace.pages, H(1), yard_reduce, yard_num, fyard_size);
+      });
+      uint64_t ice_faults = count_faults<IcebergSimulator>(trace, mem_size_mb, fyard_size,
+                                                           byard_size, reduction, family);
+      // uni-dyn hashes every bank from one hash of the page, so correlated lanes show up there
+      uint64_t uni_faults[2];
+      const char *uni_modes[2] = {"uni-dyn-ind", "uni-dyn"};
+      for (int i = 0; i < 2; i++) {
+        uni_faults[i] = count_faults<UniversalHashingSimulator>(
+            trace, mem_size_mb, way_count, std::string(uni_modes[i]),
+            UniversalHashingSimulator::FrameLayout::BANK_MAJOR, reduction, family);
+      }
+      printf("  %s: pages %lu, yard max/mean %.2f, yard stddev/mean %.2f, "
+             "fyard overflow %lu, ice faults %lu, uni-dyn-ind faults %lu, uni-dyn faults %lu\n",
+             std::filesystem::path(trace.path).filename().c_str(), trace.pages.size(),
+             load.max_over_mean, load.stddev_over_mean, load.overflow, ice_faults, uni_faults[0],
+             uni_faults[1]);
+    }
+  }
+}
+
+static void print_err_usage(const std::string& hint) {
+  std::cout << hint << '\n';
+  std::cout << "usage:\n";
+  std::cout << "./tlbsim-hashbench [-t <path-to-trace-file>]... [-m <memory-size-mb>] "
+               "[-w <bank-count>] [-f <fyard-size>] [-b <byard-size>] [-R fast|mod]\n";
+  exit(EXIT_FAILURE);
+}
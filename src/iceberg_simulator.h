@@ -1,154 +1,247 @@
 #pragma once
 
-#include <algorithm>
 #include <cstdlib>
 #include <tuple>
 #include <vector>
-#include <unordered_map>
 #include <utility>
 
 #include "constants+helper.h"
+#include "flat_page_table.h"
+#include "hash_family.h"
+#include "occupancy_bitmap.h"
 #include "page_frame.h"
+#include "range_reduce.h"
+#include "victim_select.h"
 #include "vm_simulator.h"
 
-#define XXH_STATIC_LINKING_ONLY // should keep this marco for xxhash
-#define XXH_IMPLEMENTATION      // should keep this marco for xxhash
-#include "include/xxhash.h"
+class IcebergSimulator final : public SimulatorKernel<IcebergSimulator> {
+  // the simulation loops instantiated for one hash family and yard geometry, see select_kernels()
+  using RunKernel = void(IcebergSimulator::*)(uint64_t, uint64_t, uint8_t);
+  using RunsKernel = void(IcebergSimulator::*)(const PageRun *, size_t);
 
-class IcebergSimulator : public VmSimulator {
 public:
-  IcebergSimulator(double mem_size_mb, int frontyard_size, int backyard_size)
-      : fyard_size(frontyard_size), byard_size(backyard_size),
+  IcebergSimulator(double mem_size_mb, int frontyard_size, int backyard_size,
+                   RangeReducer::Method reduction = RangeReducer::Method::FASTRANGE,
+                   hash_family::Family family = hash_family::Family::XXH64)
+      : family(family), policies(hash_family::make_policies(family, byard_candi_num + 1)),
+        fyard_size(frontyard_size), byard_size(backyard_size),
         yard_num(mem_size_mb * 1024 / PAGE_SIZE_KB / (frontyard_size + backyard_size)),
-        mem_fyards(yard_num), mem_byards(yard_num), byard_avail(yard_num, backyard_size),
-        byard_candi(byard_candi_num) {
+        yard_reduce(yard_num, reduction),
+        byard_base((size_t)yard_num * frontyard_size),
+        page_table(yard_num * (frontyard_size + backyard_size)),
+        memory((size_t)yard_num * (frontyard_size + backyard_size)), occupancy(memory.size()),
+        byard_avail(yard_num, backyard_size) {
+    select_kernels();
     print_info();
+  }
 
-    for (auto& yard : mem_fyards) {
-      yard.resize(fyard_size);
-    }
-    for (auto& yard : mem_byards) {
-      yard.resize(byard_size);
+  void access_run(uint64_t vpn, uint64_t count, uint8_t rw_mask) override {
+    (this->*run_kernel)(vpn, count, rw_mask);
+  }
+
+  void access_runs(const PageRun *runs, size_t n) override {
+    (this->*runs_kernel)(runs, n);
+  }
+
+  void prefetch_lookup(uint64_t vpn) const {
+    page_table.prefetch(vpn);
+  }
+
+  void prefetch_frame(uint64_t vpn) {
+    if (auto *loc = page_table.find(vpn)) {
+      __builtin_prefetch(&memory.timestamps[loc->slot], 1);
     }
   }
 
-  void access(uint64_t addr, char rw) override {
+  void save_state(CheckpointWriter& out) override {
+    VmSimulator::save_state(out);
+    page_table.save(out);
+    memory.save(out);
+    out.write_vector(byard_avail);
+  }
+
+  void load_state(CheckpointReader& in) override {
+    VmSimulator::load_state(in);
+    page_table.load(in);
+    memory.load(in);
+    occupancy.rebuild(memory);
+    in.read_vector(byard_avail);
+  }
+
+  virtual void print_info(std::ostream& os = std::cout) override {
+    os << "Simulator: Iceberg Simulator\n"
+       << "----------------"
+       << "\nyard_num = " << yard_num 
+       << "\nfyard_size = " << fyard_size
+       << "\nbyard_size = " << byard_size 
+       << "\nbyard_candidate_num = " << byard_candi_num
+       << "\nyard_reduction = " << yard_reduce.name()
+       << "\nhash_family = " << hash_family::name(family)
+       << "\n" << std::endl;
+  }
+
+private:
+
+  hash_family::Family family;
+  // iceberg_hash() uses seeds 0 to byard_candi_num
+  hash_family::Policies policies;
+  size_t fyard_size;
+  size_t byard_size;
+  int yard_num;
+  // maps a hash onto a yard
+  RangeReducer yard_reduce;
+  static constexpr int byard_candi_num = 6;
+  // slot of the first backyard frame in memory
+  size_t byard_base;
+
+  // map VPN to its frame slot and CPFN
+  FlatPageTable<PageLocation> page_table;
+  // frames of all frontyards yard after yard, followed by those of all backyards
+  FrameStore memory;
+  OccupancyBitmap occupancy;
+  std::vector<int> byard_avail;
+
+  uint64_t byard_candi[byard_candi_num];
+
+  RunKernel run_kernel {nullptr};
+  RunsKernel runs_kernel {nullptr};
+  victim_select::OldestRowKernel find_oldest_fyard {nullptr};
+  victim_select::OldestRowKernel find_oldest_byard {nullptr};
+
+  // The simulation step, compiled per hash family H so the hashes are inlined, and for common
+  // yard sizes (FYARD, BYARD != 0) so the yard scans have a fixed trip count, and once with the
+  // yard sizes read at runtime.
+  template <typename H, size_t FYARD, size_t BYARD>
+  void access_run_as(uint64_t vpn, uint64_t count, uint8_t rw_mask) {
     time_tick += 1;
-    stats.total_mem_access += 1;
+    stats.total_mem_access += count;
+    // the page is stamped with the tick of the last access of the run
+    uint64_t last_tick = time_tick + count - 1;
 
-    uint64_t vpn = get_page_number(addr);
-    vpn_set.insert(vpn);
+    footprint.insert(vpn);
 
-    auto find_res = page_table.find(vpn);
-    if (find_res != page_table.end()) {
+    auto *find_res = page_table.find(vpn);
+    if (find_res != nullptr) {
       // page is in the memory
-      uint32_t cpfn = find_res->second;
-      auto *frame_p = find_frame(vpn, cpfn);
-      frame_p->timestamp = time_tick;
+      memory.timestamps[find_res->slot] = last_tick;
+      time_tick = last_tick;
       return;
     }
 
     // page is not in the memory, should find a frame for it
     stats.num_page_fault += 1;
 
-    PageFrame *victim_frame = nullptr;
+    size_t victim_slot = 0;
     uint32_t victim_cpfn = 0;
     do {
-      auto [fyard_frame, fyard_cpfn] = pick_from_frontyard(vpn);
-      if (fyard_frame->free) {
-        victim_frame = fyard_frame;
-        victim_cpfn = fyard_cpfn;
+      auto [fyard_slot, fyard_cpfn] = pick_from_frontyard<H, FYARD>(vpn);
+      victim_slot = fyard_slot;
+      victim_cpfn = fyard_cpfn;
+      if (occupancy.free(fyard_slot)) {
         break;
       }
-      auto [byard_frame, byard_cpfn, byard_idx] = pick_from_backyards(vpn);
-      if (byard_frame->free) {
-        victim_frame = byard_frame;
+      auto [byard_slot, byard_cpfn, byard_idx] = pick_from_backyards<H, BYARD>(vpn);
+      if (occupancy.free(byard_slot)) {
+        victim_slot = byard_slot;
         victim_cpfn = byard_cpfn;
         byard_avail[byard_idx]--;
         break;
       }
 
       // if no free frame
-      // If it's the first swap, record memory utilization
+      // If it's the first swap, record memory utilization.
+      // Nothing was evicted so far, so every page fault brought in a distinct page.
       if (stats.num_swap_out == 0) {
-        size_t page_cnt = vpn_set.size();
+        size_t page_cnt = stats.num_page_fault;
         size_t total_frame_cnt = yard_num * (fyard_size + byard_size);
         stats.mem_util_pct = (double)page_cnt / total_frame_cnt;
       }
       stats.num_swap_out += 1;
         
-      if (fyard_frame->timestamp < byard_frame->timestamp) {
-        victim_frame = fyard_frame;
-        victim_cpfn = fyard_cpfn;
-      }
-      else {
-        victim_frame = byard_frame;
+      if (memory.timestamps[fyard_slot] >= memory.timestamps[byard_slot]) {
+        victim_slot = byard_slot;
         victim_cpfn = byard_cpfn;
       }
-      stats.total_age_of_swapped_out_pages += time_tick - victim_frame->timestamp;
+      stats.total_age_of_swapped_out_pages += time_tick - memory.timestamps[victim_slot];
 
     } while(0);
 
-    // eviction process
-    page_table.erase(victim_frame->vpn);
+    // eviction process, a free frame holds no page whose mapping could be dropped
+    if (!occupancy.free(victim_slot)) {
+      page_table.erase(memory.vpns[victim_slot]);
+    }
+    occupancy.take(victim_slot);
 
-    page_table[vpn] = victim_cpfn;
-    victim_frame->vpn = vpn;
-    victim_frame->free = false;
-    victim_frame->timestamp = time_tick;
+    page_table.insert_or_assign(vpn, {(uint32_t)victim_slot, victim_cpfn});
+    memory.vpns[victim_slot] = vpn;
+    memory.timestamps[victim_slot] = last_tick;
+    time_tick = last_tick;
   }
 
-  virtual void print_info(std::ostream& os = std::cout) override {
-    os << "Simulator: Iceberg Simulator\n"
-       << "----------------"
-       << "\nyard_num = " << yard_num 
-       << "\nfyard_size = " << fyard_size
-       << "\nbyard_size = " << byard_size 
-       << "\nbyard_candidate_num = " << byard_candi_num
-       << "\n" << std::endl;
+  template <typename H, size_t FYARD, size_t BYARD>
+  void access_runs_as(const PageRun *runs, size_t n) {
+    pipelined(runs, n, [this](const PageRun& run) {
+      access_run_as<H, FYARD, BYARD>(run.vpn, run.count, run.rw_mask);
+    });
   }
 
-private:
-  uint64_t time_tick {0};
+  template <typename H, size_t FYARD, size_t BYARD>
+  void select_kernels_for() {
+    run_kernel = &IcebergSimulator::access_run_as<H, FYARD, BYARD>;
+    runs_kernel = &IcebergSimulator::access_runs_as<H, FYARD, BYARD>;
+    find_oldest_fyard = victim_select::select_oldest_row_kernel<FYARD>();
+    find_oldest_byard = victim_select::select_oldest_row_kernel<BYARD>();
+  }
 
-  size_t fyard_size;
-  size_t byard_size;
-  int yard_num;
-  static constexpr int byard_candi_num = 6;
+  // The yard sizes of the standard configuration get loops compiled for them.
+  void select_kernels() {
+    hash_family::visit(family, [this](auto tag) {
+      using H = typename decltype(tag)::type;
+      if (fyard_size == 56 && byard_size == 8) {
+        this->template select_kernels_for<H, 56, 8>();
+      }
+      else {
+        this->template select_kernels_for<H, 0, 0>();
+      }
+    });
+  }
 
-    // map VPN to CPFN
-  std::unordered_map<uint64_t, uint32_t> page_table;
-  std::vector<std::vector<PageFrame>> mem_fyards;
-  std::vector<std::vector<PageFrame>> mem_byards;
-  std::vector<int> byard_avail;
+  template <size_t FYARD>
+  size_t fyard() const {
+    return FYARD != 0 ? FYARD : fyard_size;
+  }
 
-  std::vector<uint64_t> byard_candi;
+  template <size_t BYARD>
+  size_t byard() const {
+    return BYARD != 0 ? BYARD : byard_size;
+  }
 
-  uint64_t iceberg_hash(uint64_t vpn, int hash_index) {
-    return XXH64(&vpn, sizeof(vpn), hash_index); 
+  template <typename H>
+  uint64_t iceberg_hash(uint64_t vpn, int hash_index) const {
+    return std::get<H>(policies).hash(vpn, hash_index);
   }
 
   // Returns the first free page in the frontyard.
   // Otherwise return the frame with oldest timestamp.
-  // Returns <PageFrame*, CPFN>
-  std::pair<PageFrame*, uint32_t> pick_from_frontyard(uint64_t vpn) {
-    int fyard_id = iceberg_hash(vpn, 0) % yard_num;
-    for (size_t j = 0; j < fyard_size; j++) {
-      if (mem_fyards[fyard_id][j].free) {
-        return {&mem_fyards[fyard_id][j], j};
-      }
+  // Returns <frame slot, CPFN>
+  template <typename H, size_t FYARD>
+  std::pair<size_t, uint32_t> pick_from_frontyard(uint64_t vpn) {
+    size_t fyard_id = yard_reduce(iceberg_hash<H>(vpn, 0));
+    size_t first = fyard_id * fyard<FYARD>();
+    size_t picked = occupancy.first_free(first, fyard<FYARD>());
+    if (picked == fyard<FYARD>()) {
+      picked = find_oldest_fyard(&memory.timestamps[first], fyard<FYARD>());
     }
-    auto it = min_element(mem_fyards[fyard_id].begin(), mem_fyards[fyard_id].end(),
-                          [](auto& f1, auto& f2) { return f1.timestamp < f2.timestamp; });
-    return {&*it, it - mem_fyards[fyard_id].begin()};
+    return {first + picked, picked};
   }
   
   // Returns the first free page in the most vacant backyard.
   // Otherwise return the frame with oldest timestamp.
-  // Returns <PageFrame*, CPFN, backyard index>
-  std::tuple<PageFrame*, uint32_t, size_t> pick_from_backyards(uint64_t vpn) {
+  // Returns <frame slot, CPFN, backyard index>
+  template <typename H, size_t BYARD>
+  std::tuple<size_t, uint32_t, size_t> pick_from_backyards(uint64_t vpn) {
     for (int i = 0; i < byard_candi_num; i++) {
-      byard_candi[i] = iceberg_hash(vpn, i + 1) % yard_num;
+      byard_candi[i] = yard_reduce(iceberg_hash<H>(vpn, i + 1));
     }
     int max_avail_candi_index = -1;
     int max_avail_bucket_size = 0;
@@ -162,48 +255,29 @@ private:
     if (max_avail_bucket_size > 0) {
       // search for a free frame
       auto byard_idx = byard_candi[max_avail_candi_index];
-      for (size_t i = 0; i < byard_size; i++) {
-        if (mem_byards[byard_idx][i].free) {
-          return {&mem_byards[byard_idx][i], fyard_size + max_avail_candi_index * byard_size + i, byard_idx};
-        }
+      size_t first = byard_base + byard_idx * byard<BYARD>();
+      size_t i = occupancy.first_free(first, byard<BYARD>());
+      if (i == byard<BYARD>()) {
+        // should never reach here
+        std::exit(EXIT_FAILURE);
       }
-
-      // should never reach here
-      std::exit(EXIT_FAILURE);
+      return {first + i, fyard_size + max_avail_candi_index * byard<BYARD>() + i, byard_idx};
     }
     else {
+      // the oldest frame of each candidate backyard, the first of the oldest among them
+      size_t oldest_slot = 0;
       size_t oldest_candi_id = 0, oldest_offset = 0;
-      for (size_t i = 0; i < byard_candi.size(); i++) {
-        for (size_t j = 0; j < byard_size; j++) {
-          if (mem_byards[byard_candi[i]][j].timestamp <
-              mem_byards[byard_candi[oldest_candi_id]][oldest_offset].timestamp) {
-            oldest_candi_id = i;
-            oldest_offset = j;
-          }
+      for (size_t i = 0; i < byard_candi_num; i++) {
+        size_t first = byard_base + byard_candi[i] * byard<BYARD>();
+        size_t j = find_oldest_byard(&memory.timestamps[first], byard<BYARD>());
+        if (i == 0 || memory.timestamps[first + j] < memory.timestamps[oldest_slot]) {
+          oldest_slot = first + j;
+          oldest_candi_id = i;
+          oldest_offset = j;
         }
       }
-      return {&mem_byards[byard_candi[oldest_candi_id]][oldest_offset],
-              fyard_size + oldest_candi_id * byard_size + oldest_offset,
+      return {oldest_slot, fyard_size + oldest_candi_id * byard<BYARD>() + oldest_offset,
               byard_candi[oldest_candi_id]};
     }
   }
-
-  PageFrame *find_frame(uint64_t vpn, uint32_t cpfn) {
-    // if frame in front yard
-    if (cpfn < fyard_size) {
-      int idx = iceberg_hash(vpn, 0) % fyard_size;
-      return &mem_fyards[idx][cpfn];
-    }
-    else {
-      for (int i = 0; i < byard_candi_num; i++) {
-        byard_candi[i] = iceberg_hash(vpn, i + 1) % yard_num;
-      }
-      int candi_index = (cpfn - fyard_size) / byard_size;
-      int byard_offset = (cpfn - fyard_size) % byard_size;
-      return &mem_byards[byard_candi[candi_index]][byard_offset];
-    }
-
-    // should never reach here
-    std::exit(EXIT_FAILURE);
-  }
 };
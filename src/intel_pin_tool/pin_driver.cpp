@@ -10,6 +10,7 @@
 #include "../iceberg_simulator.h"
 #include "../universal_hashing_simulator.h"
 #include "../conventional_vm_simulator.h"
+#include "../trace_record.h"
 #include "../vm_simulator.h"
 #include "../vm_stats.h"
 
@@ -36,6 +37,11 @@ static unique_ptr<VmSimulator> simulator;
 static uint64_t access_cnt = 0;
 static uint64_t output_interval = 0;
 
+// accesses are simulated in batches, so the simulator can prefetch ahead
+static constexpr size_t ACCESS_BATCH_SIZE = 4096;
+static TraceRecord pending[ACCESS_BATCH_SIZE];
+static size_t pending_cnt = 0;
+
 /* ===================================================================== */
 // Command line switches
 /* ===================================================================== */
@@ -64,6 +70,12 @@ KNOB<int> KnobFrontyardSize(KNOB_MODE_WRITEONCE, "pintool", "f", "56",
 KNOB<int> KnobBackyardSize(KNOB_MODE_WRITEONCE, "pintool", "b", "8",
                       "for iceberg hashing: backyard size");
 
+KNOB<string> KnobRangeReduction(KNOB_MODE_WRITEONCE, "pintool", "R", "fast",
+                      "reduction of hashes to frame indices and yards (fast, mod)");
+
+KNOB<string> KnobHashFamily(KNOB_MODE_WRITEONCE, "pintool", "H", "xxh64",
+                      "hash family (xxh64, xxh3, murmur, mulshift, tab)");
+
 /* ===================================================================== */
 // Utilities
 /* ===================================================================== */
@@ -83,13 +95,22 @@ INT32 Usage() {
 // Instrumentation callbacks
 /* ===================================================================== */
 
+inline void flush_accesses() {
+  simulator->access_batch(pending, pending_cnt);
+  pending_cnt = 0;
+}
+
 inline void access(VOID *addr, char rw) {
-  simulator->access((uint64_t)addr, rw);
+  pending[pending_cnt++] = {(uint64_t)addr, rw, 0};
 
   access_cnt += 1;
   if (output_interval > 0 && access_cnt % output_interval == 0) {
+    flush_accesses();
     outFile << simulator->get_stats();
   }
+  else if (pending_cnt == ACCESS_BATCH_SIZE) {
+    flush_accesses();
+  }
 }
 
 // Print a instruction
@@ -143,6 +164,7 @@ VOID Instruction(INS ins, VOID *v) {
  *                              PIN_AddFiniFunction function call
  */
 VOID Fini(INT32 code, VOID *v) {
+  flush_accesses();
   outFile << simulator->get_stats();
   outFile << "#eof" << endl;
 }
@@ -174,15 +196,28 @@ int main(int argc, char *argv[]) {
   int way_count = KnobWayCount.Value();
   int fyard_size = KnobFrontyardSize.Value();
   int byard_size = KnobBackyardSize.Value();
+  RangeReducer::Method reduction;
+  if (!RangeReducer::parse_method(KnobRangeReduction.Value(), reduction)) {
+    fprintf(stderr, "unknown range reduction option.\n");
+    exit(EXIT_FAILURE);
+  }
+  hash_family::Family family;
+  if (!hash_family::parse(KnobHashFamily.Value(), family)) {
+    fprintf(stderr, "unknown hash family option.\n");
+    exit(EXIT_FAILURE);
+  }
 
   if (sim_option == "ice") {
-    simulator = make_unique<IcebergSimulator>(mem_size_mb, fyard_size, byard_size);
+    simulator = make_unique<IcebergSimulator>(mem_size_mb, fyard_size, byard_size, reduction,
+                                              family);
   }
   else if (sim_option == "con") {
     simulator = make_unique<ConventionalVmSimulator>(mem_size_mb);
   }
   else if (sim_options.count(sim_option) == 1) {
-    simulator = make_unique<UniversalHashingSimulator>(mem_size_mb, way_count, sim_option);
+    simulator = make_unique<UniversalHashingSimulator>(
+        mem_size_mb, way_count, sim_option, UniversalHashingSimulator::FrameLayout::BANK_MAJOR,
+        reduction, family);
   }
   else {
     fprintf(stderr, "unknown simulator option.\n");
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "page_frame.h"
+
+// One bit per frame of a FrameStore, set while the frame is free. A run of frames, such as a
+// yard, finds its first free frame with a ctz per 64 frames instead of reading timestamps.
+// Frames are only ever taken, a simulator replaces an evicted page in place.
+//
+// Not checkpointed, load_state() rebuilds it from the restored frames.
+class OccupancyBitmap {
+public:
+  explicit OccupancyBitmap(size_t frame_count = 0)
+      : words((frame_count + 63) / 64, ~0ULL), free_count(frame_count) {
+    if (frame_count % 64 != 0) {
+      words.back() = (1ULL << (frame_count % 64)) - 1;
+    }
+  }
+
+  bool free(size_t frame) const { return (words[frame / 64] >> (frame % 64)) & 1; }
+
+  // number of free frames left in the whole store
+  size_t free_frames() const { return free_count; }
+
+  void take(size_t frame) {
+    uint64_t bit = 1ULL << (frame % 64);
+    free_count -= (words[frame / 64] & bit) != 0;
+    words[frame / 64] &= ~bit;
+  }
+
+  // Returns the offset of the first free frame in [first, first + n), n if there is none.
+  size_t first_free(size_t first, size_t n) const {
+    size_t end = first + n;
+    uint64_t bits = words[first / 64] & (~0ULL << (first % 64));
+    for (size_t w = first / 64;;) {
+      if (bits != 0) {
+        size_t frame = w * 64 + __builtin_ctzll(bits);
+        return frame < end ? frame - first : n;
+      }
+      if (++w * 64 >= end) return n;
+      bits = words[w];
+    }
+  }
+
+  void rebuild(const FrameStore& frames) {
+    *this = OccupancyBitmap(frames.size());
+    for (size_t i = 0; i < frames.size(); i++) {
+      if (!frames.free(i)) take(i);
+    }
+  }
+
+private:
+  std::vector<uint64_t> words;
+  size_t free_count;
+};
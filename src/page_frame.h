@@ -2,11 +2,51 @@
 
 #include <stdint.h>
 
+#include "aligned_array.h"
+#include "checkpoint.h"
+
+// Ticks start at 1, so no page is ever stamped with this timestamp
+constexpr uint64_t FREE_TIMESTAMP = 0;
+
 struct PageFrame {
   uint64_t vpn;
-  uint64_t timestamp {0};
-  bool free {true};
+  uint64_t timestamp {FREE_TIMESTAMP};
 
   PageFrame() = default;
-  PageFrame(uint64_t vpn, uint64_t ts, bool free): vpn(vpn), timestamp(ts), free(free) {}
-};
\ No newline at end of file
+  PageFrame(uint64_t vpn, uint64_t ts): vpn(vpn), timestamp(ts) {}
+
+  bool free() const { return timestamp == FREE_TIMESTAMP; }
+};
+
+// Where a resident page lives: its slot in the simulator's FrameStore, found without hashing
+// on a hit, and its CPFN (the bank for universal hashing, the position among the candidate
+// frames for iceberg).
+struct PageLocation {
+  uint32_t slot;
+  uint32_t cpfn;
+};
+
+// Frames as two parallel aligned arrays, so LRU scans only stream the timestamps.
+// A free frame has timestamp FREE_TIMESTAMP, which is older than any page, so the
+// first-oldest frame of a set is also its first free one.
+struct FrameStore {
+  AlignedArray<uint64_t> timestamps;
+  AlignedArray<uint64_t> vpns;
+
+  explicit FrameStore(size_t frame_count = 0)
+      : timestamps(frame_count, FREE_TIMESTAMP), vpns(frame_count, 0) {}
+
+  size_t size() const { return timestamps.size(); }
+
+  bool free(size_t frame) const { return timestamps[frame] == FREE_TIMESTAMP; }
+
+  void save(CheckpointWriter& out) const {
+    timestamps.save(out);
+    vpns.save(out);
+  }
+
+  void load(CheckpointReader& in) {
+    timestamps.load(in);
+    vpns.load(in);
+  }
+};
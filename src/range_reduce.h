@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Maps hash values onto [0, range) without a division.
+//   MODULO:    hash % range, what the simulators always did; kept to reproduce old results.
+//   FASTRANGE: (hash * range) >> input bits (Lemire), a multiply and a shift. It uses the high
+//              bits of the hash, so the input must be a well mixed hash.
+// With a power-of-two range both reduce to a mask of the low bits, which equals the modulo.
+class RangeReducer {
+public:
+  enum class Method {
+    MODULO,
+    FASTRANGE
+  };
+
+  static bool parse_method(const std::string& name, Method& method) {
+    if (name == "mod") method = Method::MODULO;
+    else if (name == "fast") method = Method::FASTRANGE;
+    else return false;
+    return true;
+  }
+
+  RangeReducer() = default;
+
+  // `input_bits` is the width of the hash values, 32 or 64.
+  RangeReducer(uint64_t range, Method method, int input_bits = 64)
+      : range(range), mask(range - 1), input_bits(input_bits) {
+    if ((range & (range - 1)) == 0) {
+      kind = Kind::MASK;
+    }
+    else {
+      kind = method == Method::MODULO ? Kind::MODULO : Kind::FASTRANGE;
+    }
+  }
+
+  uint64_t operator()(uint64_t hash) const {
+    switch (kind) {
+      case Kind::MASK:
+        return hash & mask;
+      case Kind::FASTRANGE:
+        return (unsigned __int128)hash * range >> input_bits;
+      default:
+        return hash % range;
+    }
+  }
+
+  // out[i] = (*this)(hashes[i]), one tight loop per kind.
+  void reduce_all(const uint64_t *hashes, size_t n, uint32_t *out) const {
+    switch (kind) {
+      case Kind::MASK:
+        for (size_t i = 0; i < n; i++) {
+          out[i] = hashes[i] & mask;
+        }
+        break;
+      case Kind::FASTRANGE:
+        for (size_t i = 0; i < n; i++) {
+          out[i] = (unsigned __int128)hashes[i] * range >> input_bits;
+        }
+        break;
+      default:
+        for (size_t i = 0; i < n; i++) {
+          out[i] = hashes[i] % range;
+        }
+        break;
+    }
+  }
+
+  const char *name() const {
+    switch (kind) {
+      case Kind::MASK:
+        return "mask";
+      case Kind::FASTRANGE:
+        return "fastrange";
+      default:
+        return "modulo";
+    }
+  }
+
+private:
+  enum class Kind {
+    MODULO,
+    MASK,
+    FASTRANGE
+  };
+
+  uint64_t range {1};
+  uint64_t mask {0};
+  int input_bits {64};
+  Kind kind {Kind::MODULO};
+};
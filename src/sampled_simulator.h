@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "constants+helper.h"
+#include "hash_family.h"
+#include "vm_simulator.h"
+#include "vm_stats.h"
+
+// Hash-space sampling: only the pages whose hash falls into the lowest `fraction` of the hash
+// space are simulated, on a simulator built with its memory scaled down by the same fraction
+// (fewer frames per bank for universal hashing, fewer yards for iceberg). Page counts are
+// scaled back up by 1 / fraction. The clock of the sampled simulator still advances on every
+// access, so ages need no scaling.
+//
+// The sampling hash is splitmix64 of the VPN xor'ed with a key drawn from the seed. No hash
+// family of the simulators computes it, so the sample does not favour any bank or yard
+// (a family sharing the sampling hash and seeds would put every sampled page in the lowest
+// `fraction` of some bank). Several seeds give independent samples.
+class SampledSimulator final : public SimulatorKernel<SampledSimulator> {
+public:
+  SampledSimulator(std::unique_ptr<VmSimulator> inner, double fraction, uint64_t seed)
+      : inner(std::move(inner)), fraction(fraction), seed(seed),
+        sample_key(hash_family::splitmix64(seed ^ SAMPLE_SALT)) {
+    threshold = fraction >= 1 ? UINT64_MAX : (uint64_t)std::ldexp(fraction, 64);
+
+    print_info();
+  }
+
+  void access_run(uint64_t vpn, uint64_t count, uint8_t rw_mask) override {
+    total_mem_access += count;
+    if (hash_family::splitmix64(vpn ^ sample_key) <= threshold) {
+      inner->access_run(vpn, count, rw_mask);
+    }
+    else {
+      inner->advance_time(count);
+    }
+  }
+
+  // the inner simulator's tables are only touched by the sampled pages
+  void prefetch_lookup(uint64_t vpn) const {}
+  void prefetch_frame(uint64_t vpn) {}
+
+  vm_stats get_stats() override {
+    vm_stats sampled = inner->get_stats();
+    vm_stats scaled = sampled;
+    scaled.total_mem_access = total_mem_access;
+    scaled.total_page_access = std::llround(sampled.total_page_access / fraction);
+    scaled.num_page_fault = std::llround(sampled.num_page_fault / fraction);
+    scaled.num_swap_out = std::llround(sampled.num_swap_out / fraction);
+    scaled.total_age_of_swapped_out_pages =
+        std::llround(sampled.total_age_of_swapped_out_pages / fraction);
+    return scaled;
+  }
+
+  void set_footprint_mode(FootprintTracker::Mode mode) override {
+    inner->set_footprint_mode(mode);
+  }
+
+  uint64_t get_page_faults() override {
+    return inner->get_page_faults();
+  }
+
+  void save_state(CheckpointWriter& out) override {
+    VmSimulator::save_state(out);
+    out.write(total_mem_access);
+    inner->save_state(out);
+  }
+
+  void load_state(CheckpointReader& in) override {
+    VmSimulator::load_state(in);
+    in.read(total_mem_access);
+    inner->load_state(in);
+  }
+
+  virtual void print_info(std::ostream& os = std::cout) override {
+    os << "Sampling: hash-space sampled simulation\n"
+       << "----------------"
+       << "\nfraction = " << fraction
+       << "\nseed = " << seed
+       << "\n" << std::endl;
+  }
+
+private:
+  std::unique_ptr<VmSimulator> inner;
+  double fraction;
+  uint64_t seed;
+  // keeps the keys apart from the splitmix64 values the hash families derive from seeds
+  static constexpr uint64_t SAMPLE_SALT = 0x5a3d1e6b2c7f4908ULL;
+  uint64_t sample_key;
+  uint64_t threshold;
+
+  uint64_t total_mem_access {0};
+};
+
+// Mean and 95% confidence half-width of one statistic over independent sample seeds.
+struct SampledValue {
+  double mean {0};
+  double half_width {0};
+
+  static SampledValue of(const std::vector<double>& values) {
+    // two-sided 95% quantiles of Student's t distribution, by degrees of freedom
+    static const double t_95[] = {
+      12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+      2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+      2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+
+    SampledValue res;
+    size_t n = values.size();
+    if (n == 0) return res;
+    for (double v : values) {
+      res.mean += v;
+    }
+    res.mean /= n;
+    if (n < 2) return res;
+
+    double var = 0;
+    for (double v : values) {
+      var += (v - res.mean) * (v - res.mean);
+    }
+    var /= n - 1;
+    double t = n - 1 <= sizeof(t_95) / sizeof(t_95[0]) ? t_95[n - 2] : 1.96;
+    res.half_width = t * std::sqrt(var / n);
+    return res;
+  }
+};
+
+// Prints the estimate of each statistic over the seeds, with its 95% confidence interval.
+inline void print_sampled_stats(const std::vector<vm_stats>& seeds, FILE *file = stdout) {
+  auto collect = [&](auto get) {
+    std::vector<double> values;
+    for (auto& stats : seeds) {
+      values.push_back(get(stats));
+    }
+    return SampledValue::of(values);
+  };
+
+  auto page_access = collect([](auto& s) { return (double)s.total_page_access; });
+  auto page_fault = collect([](auto& s) { return (double)s.num_page_fault; });
+  auto swap_out = collect([](auto& s) { return (double)s.num_swap_out; });
+
+  fprintf(file, "Virtual Memory Statistics (%zu sampled seeds, 95%% CI)\n", seeds.size());
+  fprintf(file, "----------------\n");
+  fprintf(file, "total memory access: %lu\n", seeds.empty() ? 0 : seeds[0].total_mem_access);
+  fprintf(file, "total page access: %.0lf +- %.0lf\n", page_access.mean, page_access.half_width);
+  fprintf(file, "number of pagefaults: %.0lf +- %.0lf\n", page_fault.mean, page_fault.half_width);
+  fprintf(file, "number of swap: %.0lf +- %.0lf\n", swap_out.mean, swap_out.half_width);
+  if (swap_out.mean != 0) {
+    auto mem_util = collect([](auto& s) { return s.mem_util_pct; });
+    auto avg_age = collect([](auto& s) {
+      return s.num_swap_out == 0 ? 0.0
+                                 : (double)s.total_age_of_swapped_out_pages / s.num_swap_out;
+    });
+    fprintf(file, "first swap memory utilization: %lf +- %lf\n", mem_util.mean,
+            mem_util.half_width);
+    fprintf(file, "average age of swapped out pages: %.0lf +- %.0lf\n", avg_age.mean,
+            avg_age.half_width);
+  }
+  fprintf(file, "\n");
+}
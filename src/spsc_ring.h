@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+template <typename T>
+class SpscRing {
+public:
+  explicit SpscRing(size_t capacity) : slots(capacity + 1) {}
+
+  bool try_push(const T& value) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t next = t + 1 == slots.size() ? 0 : t + 1;
+    if (next == head.load(std::memory_order_acquire)) return false;
+
+    slots[t] = value;
+    tail.store(next, std::memory_order_release);
+    return true;
+  }
+
+  bool try_pop(T& value) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) return false;
+
+    value = slots[h];
+    head.store(h + 1 == slots.size() ? 0 : h + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Blocking variants, yield while the ring is full/empty.
+  void push(const T& value) {
+    while (!try_push(value)) {
+      std::this_thread::yield();
+    }
+  }
+
+  T pop() {
+    T value;
+    while (!try_pop(value)) {
+      std::this_thread::yield();
+    }
+    return value;
+  }
+
+private:
+  std::vector<T> slots;
+  alignas(64) std::atomic<size_t> head {0};
+  alignas(64) std::atomic<size_t> tail {0};
+};
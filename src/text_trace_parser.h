@@ -0,0 +1,211 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <immintrin.h>
+
+#include "trace_record.h"
+
+// Parser for the text trace format written by `inst_mem_trace` without `-binary`,
+// one "<type> <address>\n" line per access, e.g. "R 0x0000560feb6d7f70".
+//
+// Lines with a zero-padded 16-digit address (21 bytes) are decoded by a SIMD kernel,
+// everything else (unpadded "%p" output, "(nil)", CRLF) goes through the scalar path.
+namespace text_trace {
+
+constexpr size_t FIXED_LINE_SIZE = 21;
+constexpr size_t FIXED_HEX_OFFSET = 4;
+
+inline bool is_access_type(char c) {
+  return c == 'R' || c == 'W' || c == 'I';
+}
+
+inline bool is_fixed_line(const char *p) {
+  return is_access_type(p[0]) && p[1] == ' ' && p[2] == '0' && p[3] == 'x' &&
+         p[FIXED_LINE_SIZE - 1] == '\n';
+}
+
+inline int hex_value(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  c |= 0x20;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+// Parses one line [p, nl) of any well-formed layout. Returns false if it is malformed.
+inline bool parse_line(const char *p, const char *nl, TraceRecord& rec) {
+  if (nl > p && nl[-1] == '\r') nl--;
+  if (nl - p < 3 || !is_access_type(p[0]) || p[1] != ' ') return false;
+
+  rec.rw = p[0];
+  const char *q = p + 2;
+  if (nl - q == 5 && std::memcmp(q, "(nil)", 5) == 0) {
+    rec.addr = 0;
+    return true;
+  }
+  if (nl - q > 2 && q[0] == '0' && (q[1] == 'x' || q[1] == 'X')) {
+    q += 2;
+  }
+  if (q == nl || nl - q > 16) return false;
+
+  uint64_t addr = 0;
+  for (; q < nl; q++) {
+    int d = hex_value(*q);
+    if (d < 0) return false;
+    addr = (addr << 4) | d;
+  }
+  rec.addr = addr;
+  return true;
+}
+
+// A fixed-line kernel decodes consecutive 21-byte lines starting at `p` until it meets a line
+// it cannot handle, `end` or `max` records. Returns the number of lines decoded.
+using FixedLineKernel = size_t (*)(const char *p, const char *end, TraceRecord *out, size_t max);
+
+inline size_t parse_fixed_lines_scalar(const char *p, const char *end, TraceRecord *out,
+                                       size_t max) {
+  size_t n = 0;
+  while (n < max && end - p >= (ptrdiff_t)FIXED_LINE_SIZE && is_fixed_line(p)) {
+    uint64_t addr = 0;
+    for (size_t i = 0; i < 16; i++) {
+      int d = hex_value(p[FIXED_HEX_OFFSET + i]);
+      if (d < 0) return n;
+      addr = (addr << 4) | d;
+    }
+    out[n].rw = p[0];
+    out[n].addr = addr;
+    n++;
+    p += FIXED_LINE_SIZE;
+  }
+  return n;
+}
+
+// Converts 16 ASCII hex digits per 128-bit lane into nibbles.
+// `valid` gets 0xFF for each byte that was a hex digit.
+__attribute__((target("sse4.1")))
+inline __m128i hex_to_nibbles_sse41(__m128i c, __m128i& valid) {
+  __m128i digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+  __m128i alpha = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+  __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+  __m128i is_alpha = _mm_cmpeq_epi8(_mm_min_epu8(alpha, _mm_set1_epi8(5)), alpha);
+  valid = _mm_or_si128(is_digit, is_alpha);
+  return _mm_blendv_epi8(_mm_add_epi8(alpha, _mm_set1_epi8(10)), digit, is_digit);
+}
+
+__attribute__((target("sse4.1")))
+inline size_t parse_fixed_lines_sse41(const char *p, const char *end, TraceRecord *out,
+                                      size_t max) {
+  size_t n = 0;
+  while (n < max && end - p >= (ptrdiff_t)FIXED_LINE_SIZE && is_fixed_line(p)) {
+    __m128i valid;
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + FIXED_HEX_OFFSET));
+    __m128i nib = hex_to_nibbles_sse41(c, valid);
+    if (_mm_movemask_epi8(valid) != 0xFFFF) break;
+
+    // combine nibble pairs (hi * 16 + lo), then narrow to 8 big-endian bytes
+    __m128i pairs = _mm_maddubs_epi16(nib, _mm_set1_epi16(0x0110));
+    __m128i bytes = _mm_packus_epi16(pairs, pairs);
+
+    out[n].rw = p[0];
+    out[n].addr = __builtin_bswap64(_mm_cvtsi128_si64(bytes));
+    n++;
+    p += FIXED_LINE_SIZE;
+  }
+  return n;
+}
+
+// Decodes two lines per iteration, one in each 128-bit lane.
+__attribute__((target("avx2")))
+inline size_t parse_fixed_lines_avx2(const char *p, const char *end, TraceRecord *out,
+                                     size_t max) {
+  size_t n = 0;
+  while (n + 2 <= max && end - p >= (ptrdiff_t)(2 * FIXED_LINE_SIZE) && is_fixed_line(p) &&
+         is_fixed_line(p + FIXED_LINE_SIZE)) {
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + FIXED_HEX_OFFSET));
+    __m128i hi = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(p + FIXED_LINE_SIZE + FIXED_HEX_OFFSET));
+    __m256i c = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+
+    __m256i digit = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+    __m256i alpha =
+        _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    __m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+    __m256i is_alpha = _mm256_cmpeq_epi8(_mm256_min_epu8(alpha, _mm256_set1_epi8(5)), alpha);
+    if (_mm256_movemask_epi8(_mm256_or_si256(is_digit, is_alpha)) != -1) break;
+
+    __m256i nib =
+        _mm256_blendv_epi8(_mm256_add_epi8(alpha, _mm256_set1_epi8(10)), digit, is_digit);
+    __m256i pairs = _mm256_maddubs_epi16(nib, _mm256_set1_epi16(0x0110));
+    __m256i bytes = _mm256_packus_epi16(pairs, pairs);
+
+    out[n].rw = p[0];
+    out[n].addr = __builtin_bswap64(_mm256_extract_epi64(bytes, 0));
+    out[n + 1].rw = p[FIXED_LINE_SIZE];
+    out[n + 1].addr = __builtin_bswap64(_mm256_extract_epi64(bytes, 2));
+    n += 2;
+    p += 2 * FIXED_LINE_SIZE;
+  }
+
+  // odd tail, or a pair the wide path rejected
+  return n + parse_fixed_lines_sse41(p, end, out + n, max - n);
+}
+
+inline FixedLineKernel select_fixed_line_kernel() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return parse_fixed_lines_avx2;
+  }
+  if (__builtin_cpu_supports("sse4.1")) {
+    return parse_fixed_lines_sse41;
+  }
+  return parse_fixed_lines_scalar;
+}
+
+// Parses complete lines in [p, end) into at most `max` records. Lines that cannot be parsed
+// are skipped and counted in `malformed`. If `at_eof` is set, a final line without a newline
+// is parsed as well. Returns the number of bytes consumed and stores the record count in `n`.
+// The offsets of skipped lines from `p` are appended to `malformed_at`, if given.
+inline size_t parse_block(FixedLineKernel kernel, const char *p, const char *end, bool at_eof,
+                          TraceRecord *out, size_t max, size_t& n, uint64_t& malformed,
+                          std::vector<uint64_t> *malformed_at = nullptr) {
+  const char *begin = p;
+  n = 0;
+  while (n < max && p < end) {
+    size_t fast = kernel(p, end, out + n, max - n);
+    n += fast;
+    p += fast * FIXED_LINE_SIZE;
+    if (n == max || p == end) break;
+
+    const char *nl = static_cast<const char *>(std::memchr(p, '\n', end - p));
+    if (nl == nullptr) {
+      if (!at_eof) break;
+      nl = end;
+    }
+    if (parse_line(p, nl, out[n])) {
+      n++;
+    }
+    else if (nl != p) {
+      malformed++;
+      if (malformed_at != nullptr) {
+        malformed_at->push_back(p - begin);
+      }
+    }
+    p = nl == end ? end : nl + 1;
+  }
+  return p - begin;
+}
+
+// Heuristic used to tell text traces from binary ones: the first line is a well-formed
+// text record. Binary records are rejected because their second byte is address data.
+inline bool looks_like_text(const char *p, size_t size) {
+  if (size == 0) return false;
+  const char *nl = static_cast<const char *>(std::memchr(p, '\n', size));
+  if (nl == nullptr) return false;
+  TraceRecord rec;
+  return parse_line(p, nl, rec);
+}
+
+}  // namespace text_trace
@@ -0,0 +1,97 @@
+#include <getopt.h>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "compact_trace.h"
+#include "trace_reader.h"
+
+static void print_err_usage(const std::string& hint);
+
+constexpr size_t TRACE_BATCH_SIZE = 1 << 16;
+
+// Converts a binary or text trace into the compact delta+varint format.
+int main(int argc, char *argv[]) {
+
+  std::string input_path = "";
+  std::string output_path = "";
+  uint32_t block_records = compact_trace::DEFAULT_BLOCK_RECORDS;
+  int opt;
+
+  // i: path to the input trace, reads from stdin if omitted
+  // o: path to the output compact trace
+  // b: number of records per block
+  while (-1 != (opt = getopt(argc, argv, "i:o:b:"))) {
+    switch (opt) {
+      case 'i':
+        input_path = std::string(optarg);
+        break;
+
+      case 'o':
+        output_path = std::string(optarg);
+        break;
+
+      case 'b':
+        block_records = std::atoi(optarg);
+        break;
+
+      default:
+        print_err_usage("Invalid argument to program");
+        break;
+    }
+  }
+
+  if (output_path.empty()) {
+    print_err_usage("Missing output file");
+  }
+  if (block_records == 0) {
+    print_err_usage("Block size should be positive");
+  }
+
+  TraceReader reader;
+  if (!reader.open(input_path)) {
+    print_err_usage("Could not open the input trace file");
+  }
+
+  FILE *output = std::fopen(output_path.c_str(), "wb");
+  if (output == nullptr) {
+    print_err_usage("Could not open the output file");
+  }
+
+  uint64_t record_cnt = 0;
+  uint64_t bytes_written = 0;
+  {
+    compact_trace::CompactTraceWriter writer(output, block_records);
+    std::vector<TraceRecord> batch(TRACE_BATCH_SIZE);
+    size_t batch_len;
+    while ((batch_len = reader.read(batch.data(), batch.size())) > 0) {
+      for (size_t i = 0; i < batch_len; i++) {
+        writer.append(batch[i]);
+      }
+      record_cnt += batch_len;
+    }
+    writer.flush();
+    bytes_written = writer.get_bytes_written();
+  }
+  std::fclose(output);
+
+  uint64_t bytes_read = reader.bytes_read();
+  printf("records: %lu\n", record_cnt);
+  printf("input bytes: %lu\n", bytes_read);
+  printf("output bytes: %lu\n", bytes_written);
+  if (bytes_written > 0) {
+    printf("compression ratio: %.2lf\n", (double)bytes_read / bytes_written);
+  }
+  if (reader.malformed_records() > 0) {
+    printf("skipped malformed lines: %lu\n", reader.malformed_records());
+  }
+}
+
+static void print_err_usage(const std::string& hint) {
+  std::cout << hint << '\n';
+  std::cout << "usage:\n";
+  std::cout << "./tlbsim-convert -i <path-to-trace-file> -o <path-to-output> [-b <block-records>]\n";
+  exit(EXIT_FAILURE);
+}
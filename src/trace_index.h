@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Sidecar index of a trace (<trace>.idx by default). Maps record numbers to the byte offsets
+// where decoding can restart, so a run can resume mid-trace without decoding from the start.
+//
+// file  := magic[8] = "TLBTIDX1", uint64 trace_size, uint64 entry_count, entry*
+// entry := uint64 record, uint64 byte_offset
+class TraceIndex {
+public:
+  static constexpr char MAGIC[8] = {'T', 'L', 'B', 'T', 'I', 'D', 'X', '1'};
+  static constexpr uint64_t DEFAULT_INTERVAL = 1 << 20;
+
+  struct Entry {
+    uint64_t record;
+    uint64_t offset;
+  };
+
+  explicit TraceIndex(uint64_t interval = DEFAULT_INTERVAL) : interval(interval) {}
+
+  // Records a restart point, entries closer than `interval` records to the last one are dropped.
+  // Called by the decoding thread.
+  void add(uint64_t record, uint64_t offset) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (entries.empty() || record >= entries.back().record + interval) {
+      entries.push_back({record, offset});
+    }
+  }
+
+  // Finds the last restart point at or before `record`. Returns false if there is none.
+  bool lookup(uint64_t record, Entry& entry) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = std::upper_bound(entries.begin(), entries.end(), record,
+                               [](uint64_t r, const Entry& e) { return r < e.record; });
+    if (it == entries.begin()) return false;
+    entry = *--it;
+    return true;
+  }
+
+  bool save(const std::string& path, uint64_t trace_size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string tmp_path = path + ".tmp";
+    FILE *file = std::fopen(tmp_path.c_str(), "wb");
+    if (file == nullptr) return false;
+
+    uint64_t entry_count = entries.size();
+    bool ok = std::fwrite(MAGIC, sizeof(MAGIC), 1, file) == 1 &&
+              std::fwrite(&trace_size, sizeof(trace_size), 1, file) == 1 &&
+              std::fwrite(&entry_count, sizeof(entry_count), 1, file) == 1 &&
+              std::fwrite(entries.data(), sizeof(Entry), entry_count, file) == entry_count;
+    ok = std::fclose(file) == 0 && ok;
+    return ok && std::rename(tmp_path.c_str(), path.c_str()) == 0;
+  }
+
+  // Fails if the file is missing, malformed, or was built for a trace of another size.
+  bool load(const std::string& path, uint64_t trace_size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    FILE *file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) return false;
+
+    char magic[sizeof(MAGIC)];
+    uint64_t size = 0, entry_count = 0;
+    bool ok = std::fread(magic, sizeof(magic), 1, file) == 1 &&
+              std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0 &&
+              std::fread(&size, sizeof(size), 1, file) == 1 && size == trace_size &&
+              std::fread(&entry_count, sizeof(entry_count), 1, file) == 1;
+    if (ok) {
+      entries.resize(entry_count);
+      ok = std::fread(entries.data(), sizeof(Entry), entry_count, file) == entry_count;
+    }
+    std::fclose(file);
+    if (!ok) {
+      entries.clear();
+    }
+    return ok;
+  }
+
+private:
+  uint64_t interval;
+  std::vector<Entry> entries;
+  std::mutex mutex;
+};
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "trace_reader.h"
+#include "trace_record.h"
+
+// Merges several traces into one stream, as if their processes shared the machine. Inputs
+// take turns in order, input i contributing `turns[i]` consecutive records per turn: turns of
+// 1 give a record-level round robin, equal turns a scheduling quantum, unequal ones a weighted
+// ratio. Every record is tagged with the index of its input as address space ID. An input
+// that ends drops out of the rotation.
+class TraceInterleaver {
+public:
+  static constexpr size_t MAX_INPUTS = 256;
+
+  TraceInterleaver(std::vector<TraceReader *> readers, std::vector<uint64_t> turns,
+                   size_t buffer_size = 1 << 14)
+      : readers(readers), turns(turns), inputs(readers.size()) {
+    for (auto& input : inputs) {
+      input.buffer.resize(buffer_size);
+    }
+    reset(std::vector<uint64_t>(readers.size(), 0));
+  }
+
+  size_t size() const { return readers.size(); }
+
+  TraceReader& reader(size_t i) const { return *readers[i]; }
+
+  uint64_t get_turn(size_t i) const { return turns[i]; }
+
+  // Fills `out` with up to `max` interleaved records. Returns 0 once every input has ended.
+  size_t read(TraceRecord *out, size_t max) {
+    size_t n = 0;
+    while (n < max && active > 0) {
+      Input& input = inputs[current];
+      if (input.ended) {
+        next_turn();
+        continue;
+      }
+      if (input.pos == input.len) {
+        input.pos = 0;
+        input.len = readers[current]->read(input.buffer.data(), input.buffer.size());
+        if (input.len == 0) {
+          input.ended = true;
+          active--;
+          next_turn();
+          continue;
+        }
+      }
+
+      size_t cnt = std::min<uint64_t>({turn_left, input.len - input.pos, max - n});
+      for (size_t i = 0; i < cnt; i++) {
+        out[n + i] = input.buffer[input.pos + i];
+        out[n + i].asid = (uint8_t)current;
+      }
+      input.pos += cnt;
+      n += cnt;
+      turn_left -= cnt;
+      if (turn_left == 0) {
+        next_turn();
+      }
+    }
+    return n;
+  }
+
+  // Positions every input after the given number of its records, as taken by read(), and
+  // restores the rotation to where it was at that point. Returns false if an input is too short.
+  bool seek(const std::vector<uint64_t>& records) {
+    for (size_t i = 0; i < readers.size(); i++) {
+      if (!readers[i]->seek_record(records[i])) return false;
+    }
+    reset(records);
+    return true;
+  }
+
+  uint64_t malformed_records() const {
+    uint64_t total = 0;
+    for (auto *reader : readers) {
+      total += reader->malformed_records();
+    }
+    return total;
+  }
+
+private:
+  struct Input {
+    std::vector<TraceRecord> buffer;
+    size_t pos {0};
+    size_t len {0};
+    bool ended {false};
+  };
+
+  void next_turn() {
+    current = (current + 1) % inputs.size();
+    turn_left = turns[current];
+  }
+
+  // Replays the rotation over `records` already taken from each input. An input that fell
+  // short of its turn while others went on afterwards must have ended there.
+  void reset(std::vector<uint64_t> left) {
+    for (auto& input : inputs) {
+      input = {std::move(input.buffer)};
+    }
+    active = inputs.size();
+    current = 0;
+    turn_left = turns[0];
+
+    uint64_t total = 0;
+    for (uint64_t cnt : left) {
+      total += cnt;
+    }
+    while (total > 0) {
+      if (current == 0 && turn_left == turns[0]) {
+        // skip whole rounds at once
+        uint64_t rounds = UINT64_MAX;
+        for (size_t i = 0; i < inputs.size(); i++) {
+          if (!inputs[i].ended) {
+            rounds = std::min(rounds, left[i] / turns[i]);
+          }
+        }
+        for (size_t i = 0; i < inputs.size(); i++) {
+          if (!inputs[i].ended) {
+            left[i] -= rounds * turns[i];
+            total -= rounds * turns[i];
+          }
+        }
+        if (total == 0) break;
+      }
+
+      if (inputs[current].ended) {
+        next_turn();
+        continue;
+      }
+      uint64_t cnt = std::min(turn_left, left[current]);
+      left[current] -= cnt;
+      total -= cnt;
+      turn_left -= cnt;
+      if (turn_left == 0) {
+        next_turn();
+      }
+      else if (total > 0) {
+        inputs[current].ended = true;
+        active--;
+        next_turn();
+      }
+    }
+  }
+
+  std::vector<TraceReader *> readers;
+  std::vector<uint64_t> turns;
+  std::vector<Input> inputs;
+
+  size_t active {0};
+  size_t current {0};
+  uint64_t turn_left {0};
+};
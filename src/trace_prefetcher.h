@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include "constants+helper.h"
+#include "spsc_ring.h"
+#include "trace_interleaver.h"
+
+// A fixed-size batch of decoded trace records, along with the same records collapsed into
+// runs of consecutive accesses to one page.
+struct TraceBatch {
+  std::vector<TraceRecord> records;
+  size_t size {0};
+  std::vector<PageRun> runs;
+};
+
+inline void collapse_page_runs(const TraceRecord *records, size_t n, std::vector<PageRun>& runs) {
+  runs.clear();
+  for (size_t i = 0; i < n;) {
+    uint8_t asid = records[i].asid;
+    uint64_t vpn = get_tagged_page_number(records[i].addr, asid);
+    uint8_t rw_mask = get_access_type_mask(records[i].rw);
+    size_t j = i + 1;
+    while (j < n && get_tagged_page_number(records[j].addr, records[j].asid) == vpn) {
+      rw_mask |= get_access_type_mask(records[j].rw);
+      j++;
+    }
+    runs.push_back({vpn, (uint32_t)(j - i), rw_mask, asid});
+    i = j;
+  }
+}
+
+// Reads and decodes the traces on a producer thread, so trace I/O and decompression overlap
+// with simulation. Decoded batches are handed to the consumer through an SPSC ring and
+// recycled through a second one once the consumer releases them.
+class TracePrefetcher {
+public:
+  TracePrefetcher(TraceInterleaver& reader, size_t batch_size, size_t batch_count = 4)
+      : reader(reader), batches(batch_count), full(batch_count), free(batch_count) {
+    for (auto& batch : batches) {
+      batch.records.resize(batch_size);
+      batch.runs.reserve(batch_size);
+      free.push(&batch);
+    }
+    producer = std::thread(&TracePrefetcher::produce, this);
+  }
+
+  TracePrefetcher(const TracePrefetcher&) = delete;
+  TracePrefetcher& operator=(const TracePrefetcher&) = delete;
+
+  ~TracePrefetcher() {
+    // drain so the producer is never stuck on a full ring
+    while (!finished) {
+      release(next());
+    }
+    producer.join();
+  }
+
+  // Returns the next decoded batch, or nullptr at the end of the trace.
+  // Every returned batch must be given back with release().
+  TraceBatch *next() {
+    if (finished) return nullptr;
+
+    TraceBatch *batch = full.pop();
+    if (batch == nullptr) {
+      finished = true;
+    }
+    return batch;
+  }
+
+  void release(TraceBatch *batch) {
+    if (batch != nullptr) {
+      free.push(batch);
+    }
+  }
+
+private:
+  void produce() {
+    while (true) {
+      TraceBatch *batch = free.pop();
+      batch->size = reader.read(batch->records.data(), batch->records.size());
+      if (batch->size == 0) {
+        full.push(nullptr);
+        return;
+      }
+      collapse_page_runs(batch->records.data(), batch->size, batch->runs);
+      full.push(batch);
+    }
+  }
+
+  TraceInterleaver& reader;
+  std::vector<TraceBatch> batches;
+
+  // producer -> consumer, nullptr marks the end of the trace
+  SpscRing<TraceBatch *> full;
+  // consumer -> producer
+  SpscRing<TraceBatch *> free;
+
+  bool finished {false};
+  std::thread producer;
+};
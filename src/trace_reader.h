@@ -0,0 +1,378 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "compact_trace.h"
+#include "text_trace_parser.h"
+#include "trace_index.h"
+#include "trace_record.h"
+
+// Provides a sliding window of raw trace bytes.
+// Regular files are mmap'd as a whole and walked in place. Pipes and stdin fall back to
+// large-block read() into an internal buffer.
+class TraceSource {
+public:
+  static constexpr size_t READ_BLOCK_SIZE = 16 << 20;
+
+  TraceSource() = default;
+  TraceSource(const TraceSource&) = delete;
+  TraceSource& operator=(const TraceSource&) = delete;
+
+  ~TraceSource() { close(); }
+
+  // Opens `path`, or stdin if `path` is empty or "-". Returns false on failure.
+  bool open(const std::string& path) {
+    close();
+
+    if (path.empty() || path == "-") {
+      fd = STDIN_FILENO;
+    }
+    else {
+      fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0) return false;
+      owns_fd = true;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+      void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr != MAP_FAILED) {
+        madvise(addr, st.st_size, MADV_SEQUENTIAL);
+        map_base = static_cast<char *>(addr);
+        map_size = st.st_size;
+        cur = map_base;
+        end = map_base + map_size;
+        return true;
+      }
+    }
+
+    buffer.resize(READ_BLOCK_SIZE);
+    cur = end = buffer.data();
+    return true;
+  }
+
+  void close() {
+    if (map_base != nullptr) {
+      munmap(map_base, map_size);
+      map_base = nullptr;
+      map_size = 0;
+    }
+    if (owns_fd) {
+      ::close(fd);
+      owns_fd = false;
+    }
+    fd = -1;
+    cur = end = nullptr;
+    consumed = 0;
+    stream_eof = false;
+  }
+
+  bool is_mapped() const { return map_base != nullptr; }
+
+  // Size of the mmap'd file, 0 for streams.
+  uint64_t file_size() const { return map_size; }
+
+  // Moves the window to byte `offset`. Only possible on mmap'd files.
+  bool seek(uint64_t offset) {
+    if (!is_mapped() || offset > map_size) return false;
+    cur = map_base + offset;
+    consumed = offset;
+    return true;
+  }
+
+  // Unconsumed bytes currently in the window.
+  const char *data() const { return cur; }
+  size_t size() const { return end - cur; }
+
+  void consume(size_t n) {
+    cur += n;
+    consumed += n;
+  }
+
+  // Byte offset of data() from the beginning of the trace.
+  uint64_t offset() const { return consumed; }
+
+  // Appends more bytes to the window, keeping the unconsumed tail. The buffer grows if the
+  // tail already fills it. Returns false if no more bytes could be added.
+  bool refill() {
+    if (is_mapped() || stream_eof || fd < 0) return false;
+
+    size_t tail = size();
+    std::memmove(buffer.data(), cur, tail);
+    if (tail == buffer.size()) {
+      buffer.resize(buffer.size() * 2);
+    }
+    cur = buffer.data();
+    end = cur + tail;
+
+    size_t added = 0;
+    while (end < buffer.data() + buffer.size()) {
+      ssize_t res = ::read(fd, end, buffer.data() + buffer.size() - end);
+      if (res < 0 && errno == EINTR) continue;
+      if (res <= 0) {
+        stream_eof = true;
+        break;
+      }
+      end += res;
+      added += res;
+    }
+    return added > 0;
+  }
+
+private:
+  int fd {-1};
+  bool owns_fd {false};
+  bool stream_eof {false};
+
+  char *map_base {nullptr};
+  size_t map_size {0};
+
+  std::vector<char> buffer;
+
+  char *cur {nullptr};
+  char *end {nullptr};
+  uint64_t consumed {0};
+};
+
+enum class TraceFormat {
+  BINARY,
+  TEXT,
+  COMPACT
+};
+
+// Decodes a trace into batches of TraceRecord. The format is detected when the trace is opened.
+class TraceReader {
+public:
+  bool open(const std::string& path) {
+    if (!source.open(path)) return false;
+
+    if (source.size() == 0) {
+      source.refill();
+    }
+    if (compact_trace::has_magic(source.data(), source.size())) {
+      format = TraceFormat::COMPACT;
+      if (source.size() < compact_trace::FILE_HEADER_SIZE) return false;
+      source.consume(compact_trace::FILE_HEADER_SIZE);
+    }
+    else if (text_trace::looks_like_text(source.data(), source.size())) {
+      format = TraceFormat::TEXT;
+    }
+    else {
+      format = TraceFormat::BINARY;
+    }
+    malformed = 0;
+    malformed_log.clear();
+    block_left = 0;
+    records_read = 0;
+    start_offset = source.offset();
+    return true;
+  }
+
+  // Makes the reader record restart points into `idx` while decoding.
+  void set_index(TraceIndex *idx) { index = idx; }
+
+  // Positions the reader at record number `record`, jumping to the closest restart point in
+  // the index first. Only works on regular files. Returns false if the trace is too short.
+  bool seek_record(uint64_t record) {
+    TraceIndex::Entry entry {0, start_offset};
+    if (index != nullptr) {
+      index->lookup(record, entry);
+    }
+    if (!source.seek(entry.offset)) return false;
+    records_read = entry.record;
+    block_left = 0;
+
+    std::vector<TraceRecord> skipped(1 << 16);
+    while (records_read < record) {
+      size_t want = std::min<uint64_t>(skipped.size(), record - records_read);
+      if (read(skipped.data(), want) == 0) return false;
+    }
+    return true;
+  }
+
+  TraceFormat get_format() const { return format; }
+
+  // Decodes up to `max` records into `out`. Returns the number of records decoded,
+  // 0 at the end of the trace. A trailing partial binary record is ignored.
+  size_t read(TraceRecord *out, size_t max) {
+    // between calls the reader always sits on a line or record boundary, but compact traces
+    // can only restart at block boundaries
+    if (index != nullptr && block_left == 0) {
+      index->add(records_read, source.offset());
+    }
+
+    size_t n;
+    switch (format) {
+      case TraceFormat::TEXT:
+        n = read_text(out, max);
+        break;
+      case TraceFormat::COMPACT:
+        n = read_compact(out, max);
+        break;
+      default:
+        n = read_binary(out, max);
+        break;
+    }
+    records_read += n;
+    return n;
+  }
+
+  uint64_t bytes_read() const { return source.offset(); }
+
+  uint64_t get_records_read() const { return records_read; }
+
+  uint64_t file_size() const { return source.file_size(); }
+
+  // Number of text lines skipped because they could not be parsed.
+  uint64_t malformed_records() const { return malformed; }
+
+  // Makes the reader keep the byte offsets of the first `limit` skipped text lines.
+  void log_malformed(size_t limit) { malformed_limit = limit; }
+
+  const std::vector<uint64_t>& malformed_offsets() const { return malformed_log; }
+
+private:
+  size_t read_binary(TraceRecord *out, size_t max) {
+    size_t n = 0;
+    while (n < max) {
+      size_t avail = source.size() / BINARY_RECORD_SIZE;
+      if (avail == 0) {
+        if (!source.refill()) break;
+        continue;
+      }
+
+      size_t cnt = std::min(avail, max - n);
+      const char *p = source.data();
+      for (size_t i = 0; i < cnt; i++, p += BINARY_RECORD_SIZE) {
+        out[n + i].rw = p[0];
+        std::memcpy(&out[n + i].addr, p + 1, sizeof(uint64_t));
+      }
+      source.consume(cnt * BINARY_RECORD_SIZE);
+      n += cnt;
+    }
+    return n;
+  }
+
+  size_t read_text(TraceRecord *out, size_t max) {
+    size_t n = 0;
+    bool at_eof = source.is_mapped();
+    while (n < max) {
+      size_t parsed = 0;
+      bool logging = malformed_log.size() < malformed_limit;
+      malformed_at.clear();
+      size_t used = text_trace::parse_block(text_kernel, source.data(),
+                                            source.data() + source.size(), at_eof, out + n,
+                                            max - n, parsed, malformed,
+                                            logging ? &malformed_at : nullptr);
+      for (size_t i = 0; i < malformed_at.size() && malformed_log.size() < malformed_limit; i++) {
+        malformed_log.push_back(source.offset() + malformed_at[i]);
+      }
+      source.consume(used);
+      n += parsed;
+      if (n == max) break;
+      if (used == 0 || source.size() == 0) {
+        // the window holds at most a partial line
+        if (source.refill()) continue;
+        if (at_eof || source.size() == 0) break;
+        at_eof = true;
+      }
+    }
+    return n;
+  }
+
+  size_t read_compact(TraceRecord *out, size_t max) {
+    size_t n = 0;
+    while (n < max) {
+      if (block_left == 0 && !start_compact_block()) break;
+
+      size_t cnt = std::min<size_t>(block_left, max - n);
+      const uint8_t *begin = reinterpret_cast<const uint8_t *>(source.data());
+      const uint8_t *p = begin;
+      if (!compact_trace::decode_records(p, begin + block_bytes_left, block_prev, out + n,
+                                         cnt)) {
+        reject_compact_block();
+      }
+      source.consume(p - begin);
+      block_left -= cnt;
+      block_bytes_left -= p - begin;
+      n += cnt;
+
+      if (block_left == 0) {
+        // the records must take up exactly the payload
+        if (block_bytes_left != 0) reject_compact_block();
+        source.consume(compact_trace::BLOCK_PADDING);
+      }
+    }
+    return n;
+  }
+
+  // Makes sure the next block is entirely in the window, then steps over its header.
+  bool start_compact_block() {
+    uint32_t header[2];
+    while (true) {
+      if (source.size() >= compact_trace::BLOCK_HEADER_SIZE) {
+        std::memcpy(header, source.data(), compact_trace::BLOCK_HEADER_SIZE);
+        if (source.size() >=
+            compact_trace::BLOCK_HEADER_SIZE + header[1] + compact_trace::BLOCK_PADDING) {
+          break;
+        }
+      }
+      if (!source.refill()) {
+        // bytes left over after the last whole block are a truncated block
+        if (source.size() != 0) {
+          block_offset = source.offset();
+          reject_compact_block();
+        }
+        return false;
+      }
+    }
+
+    block_offset = source.offset();
+    // every record takes at least one byte
+    if (header[0] > header[1]) reject_compact_block();
+
+    source.consume(compact_trace::BLOCK_HEADER_SIZE);
+    block_left = header[0];
+    block_bytes_left = header[1];
+    block_prev = 0;
+    return true;
+  }
+
+  // A corrupt block cannot be skipped, the following blocks cannot be located reliably.
+  [[noreturn]] void reject_compact_block() {
+    fprintf(stderr, "corrupt compact trace block at byte offset %lu\n", block_offset);
+    std::exit(EXIT_FAILURE);
+  }
+
+  TraceSource source;
+  TraceFormat format {TraceFormat::BINARY};
+  uint64_t malformed {0};
+  uint64_t records_read {0};
+  uint64_t start_offset {0};
+  TraceIndex *index {nullptr};
+
+  // offsets of skipped text lines
+  size_t malformed_limit {0};
+  std::vector<uint64_t> malformed_log;
+  std::vector<uint64_t> malformed_at;
+
+  // decoding state of the current compact block
+  uint32_t block_left {0};
+  uint32_t block_bytes_left {0};
+  uint64_t block_prev {0};
+  uint64_t block_offset {0};
+
+  text_trace::FixedLineKernel text_kernel {text_trace::select_fixed_line_kernel()};
+};
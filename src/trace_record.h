@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// One decoded trace record.
+struct TraceRecord {
+  uint64_t addr;
+  char rw;
+  // address space of the trace the record came from, see TraceInterleaver
+  uint8_t asid;
+};
+
+// Consecutive accesses to the same page, simulated as one step.
+struct PageRun {
+  uint64_t vpn;
+  uint32_t count;
+  // ACCESS_* bits of the access types in the run
+  uint8_t rw_mask;
+  uint8_t asid;
+};
+
+// The binary trace emitted by `inst_mem_trace -binary 1` is a packed stream of
+// { char type; uint64_t addr; } records, i.e. 9 bytes each in host byte order.
+constexpr size_t BINARY_RECORD_SIZE = sizeof(char) + sizeof(uint64_t);
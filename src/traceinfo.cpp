@@ -0,0 +1,200 @@
+#include <getopt.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "constants+helper.h"
+#include "trace_reader.h"
+
+static void print_err_usage(const std::string& hint);
+
+constexpr size_t TRACE_BATCH_SIZE = 1 << 16;
+
+// Set of page numbers with open addressing, a page is stored as page + 1 so 0 marks an
+// empty slot.
+class PageSet {
+public:
+  PageSet() : slots(1 << 10, 0) {}
+
+  void insert(uint64_t page) {
+    uint64_t key = page + 1;
+    size_t mask = slots.size() - 1;
+    size_t i = hash(key) & mask;
+    while (slots[i] != 0) {
+      if (slots[i] == key) return;
+      i = (i + 1) & mask;
+    }
+    slots[i] = key;
+    if (++count * 2 > slots.size()) {
+      grow();
+    }
+  }
+
+  uint64_t size() const { return count; }
+
+private:
+  static size_t hash(uint64_t key) {
+    return (key * 0x9e3779b97f4a7c15ULL) >> 20;
+  }
+
+  void grow() {
+    std::vector<uint64_t> old(slots.size() * 2, 0);
+    old.swap(slots);
+    size_t mask = slots.size() - 1;
+    for (uint64_t key : old) {
+      if (key == 0) continue;
+      size_t i = hash(key) & mask;
+      while (slots[i] != 0) {
+        i = (i + 1) & mask;
+      }
+      slots[i] = key;
+    }
+  }
+
+  std::vector<uint64_t> slots;
+  uint64_t count {0};
+};
+
+// Working set of the trace at one page size.
+struct PageSizeFootprint {
+  const char *name;
+  int bits;
+  PageSet pages;
+  uint64_t last_page {UINT64_MAX};
+};
+
+// Scans a trace and prints what is needed to pick the simulated memory size: the record counts
+// by type, the address ranges touched, malformed records and the working set at several page
+// sizes.
+int main(int argc, char *argv[]) {
+
+  std::string trace_path = "";
+  size_t max_locations = 10;
+  int opt;
+
+  // t: path to the trace, reads from stdin if omitted
+  // n: number of malformed record locations to list
+  while (-1 != (opt = getopt(argc, argv, "t:n:"))) {
+    switch (opt) {
+      case 't':
+        trace_path = std::string(optarg);
+        break;
+
+      case 'n':
+        max_locations = std::atoi(optarg);
+        break;
+
+      default:
+        print_err_usage("Invalid argument to program");
+        break;
+    }
+  }
+
+  TraceReader reader;
+  if (!reader.open(trace_path)) {
+    print_err_usage("Could not open the trace file");
+  }
+  reader.log_malformed(max_locations);
+
+  PageSizeFootprint footprints[] = {
+    {"4KB", PAGE_SIZE_BITS},
+    {"64KB", 16},
+    {"2MB", 21},
+    {"1GB", 30},
+  };
+
+  uint64_t type_cnt[256] = {};
+  // bucket i counts the addresses in [2^(i-1), 2^i), bucket 0 counts address 0
+  uint64_t addr_hist[65] = {};
+  uint64_t min_addr = UINT64_MAX, max_addr = 0;
+  // records of binary and compact traces whose type is not I, R or W
+  uint64_t bad_type_cnt = 0;
+  std::vector<std::pair<uint64_t, char>> bad_types;
+
+  uint64_t record_cnt = 0;
+  std::vector<TraceRecord> batch(TRACE_BATCH_SIZE);
+  size_t batch_len;
+  while ((batch_len = reader.read(batch.data(), batch.size())) > 0) {
+    for (size_t i = 0; i < batch_len; i++) {
+      uint64_t addr = batch[i].addr;
+      uint8_t rw = batch[i].rw;
+
+      type_cnt[rw]++;
+      if (get_access_type_mask(rw) == 0) {
+        if (bad_types.size() < max_locations) {
+          bad_types.push_back({record_cnt + i, (char)rw});
+        }
+        bad_type_cnt++;
+      }
+      addr_hist[addr == 0 ? 0 : 64 - __builtin_clzll(addr)]++;
+      min_addr = std::min(min_addr, addr);
+      max_addr = std::max(max_addr, addr);
+
+      for (auto& fp : footprints) {
+        uint64_t page = addr >> fp.bits;
+        if (page != fp.last_page) {
+          fp.pages.insert(page);
+          fp.last_page = page;
+        }
+      }
+    }
+    record_cnt += batch_len;
+  }
+
+  const char *format = reader.get_format() == TraceFormat::TEXT      ? "text"
+                       : reader.get_format() == TraceFormat::COMPACT ? "compact"
+                                                                     : "binary";
+  printf("format: %s\n", format);
+  printf("trace bytes: %lu\n", reader.bytes_read());
+  printf("records: %lu\n", record_cnt);
+  printf("instruction fetches: %lu\n", type_cnt['I'] + type_cnt['i']);
+  printf("reads: %lu\n", type_cnt['R'] + type_cnt['r']);
+  printf("writes: %lu\n", type_cnt['W'] + type_cnt['w']);
+  printf("other types: %lu\n", bad_type_cnt);
+  for (auto& bad : bad_types) {
+    if (reader.get_format() == TraceFormat::BINARY) {
+      printf("  record %lu (byte offset %lu): type 0x%02x\n", bad.first,
+             bad.first * BINARY_RECORD_SIZE, (uint8_t)bad.second);
+    }
+    else {
+      printf("  record %lu: type 0x%02x\n", bad.first, (uint8_t)bad.second);
+    }
+  }
+  printf("malformed lines: %lu\n", reader.malformed_records());
+  for (uint64_t offset : reader.malformed_offsets()) {
+    printf("  byte offset %lu\n", offset);
+  }
+  printf("\n");
+
+  if (record_cnt > 0) {
+    printf("lowest address: 0x%lx\n", min_addr);
+    printf("highest address: 0x%lx\n", max_addr);
+  }
+  printf("address histogram:\n");
+  for (int i = 0; i <= 64; i++) {
+    if (addr_hist[i] == 0) continue;
+    uint64_t lo = i == 0 ? 0 : 1ULL << (i - 1);
+    printf("  [0x%lx, 0x%lx]: %lu\n", lo, i == 0 ? 0 : lo + (lo - 1), addr_hist[i]);
+  }
+  printf("\n");
+
+  for (auto& fp : footprints) {
+    double mb = std::ldexp((double)fp.pages.size(), fp.bits - 20);
+    printf("unique pages (%s): %lu\n", fp.name, fp.pages.size());
+    printf("working set (%s pages, MB): %.2lf\n", fp.name, mb);
+  }
+
+  // the simulators use 4KB pages, so a memory this large never swaps under -s con
+  double ws_mb = std::ldexp((double)footprints[0].pages.size(), PAGE_SIZE_BITS - 20);
+  printf("\nsmallest -m without swapping: %.0lf\n", std::ceil(ws_mb));
+}
+
+static void print_err_usage(const std::string& hint) {
+  std::cout << hint << '\n';
+  std::cout << "usage:\n";
+  std::cout << "./tlbsim-traceinfo [-t <path-to-trace-file>] [-n <malformed-locations>]\n";
+  exit(EXIT_FAILURE);
+}
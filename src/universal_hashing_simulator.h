@@ -2,19 +2,27 @@
 
 #include "vm_simulator.h"
 #include "constants+helper.h"
+#include "flat_page_table.h"
+#include "hash_family.h"
+#include "occupancy_bitmap.h"
 #include "page_frame.h"
+#include "range_reduce.h"
+#include "victim_select.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 #include <random>
+#include <type_traits>
 
 #define XXH_STATIC_LINKING_ONLY // should keep this marco for xxhash
 #define XXH_IMPLEMENTATION      // should keep this marco for xxhash
 #include "include/xxhash.h"
 
-class UniversalHashingSimulator : public VmSimulator {
+class UniversalHashingSimulator final : public SimulatorKernel<UniversalHashingSimulator> {
 
 enum Mode {
   M_STATIC,
@@ -24,8 +32,9 @@ enum Mode {
   M_DYNAMIC_ONE_HASH_XOR
 };
 
-// function pointer to the function that is used to hash the VPN
-using Indexer = uint32_t(UniversalHashingSimulator::*)(uint64_t, uint64_t, int);
+// the simulation loops instantiated for one hash mode and family, see select_kernels()
+using RunKernel = void(UniversalHashingSimulator::*)(uint64_t, uint64_t, uint8_t);
+using RunsKernel = void(UniversalHashingSimulator::*)(const PageRun *, size_t);
 
 inline static std::unordered_map<std::string, Mode> options_map {
   { "uni-static", M_STATIC },
@@ -36,37 +45,54 @@ inline static std::unordered_map<std::string, Mode> options_map {
 };
 
 public:
-  UniversalHashingSimulator(double mem_size_mb, int bank_count, const std::string& mode)
-      : bank_count(bank_count), sim_mode_name(mode) {
+  // Placement of the frames in memory: bank after bank, or the frames with the same index
+  // in every bank next to each other.
+  enum class FrameLayout {
+    BANK_MAJOR,
+    INDEX_MAJOR
+  };
+
+  UniversalHashingSimulator(double mem_size_mb, int bank_count, const std::string& mode,
+                            FrameLayout layout = FrameLayout::BANK_MAJOR,
+                            RangeReducer::Method reduction = RangeReducer::Method::FASTRANGE,
+                            hash_family::Family family = hash_family::Family::XXH64)
+      : bank_count(bank_count), family(family),
+        policies(hash_family::make_policies(family, std::max(bank_count, 2))),
+        frame_layout(layout), sim_mode_name(mode) {
 
     if (options_map.count(mode) == 1) {
       sim_mode = options_map[mode];
     }
 
     frame_per_bank = mem_size_mb * 1024 / PAGE_SIZE_KB / bank_count;
+    if (frame_layout == FrameLayout::BANK_MAJOR) {
+      bank_stride = frame_per_bank;
+      index_stride = 1;
+    }
+    else {
+      bank_stride = 1;
+      index_stride = bank_count;
+    }
+
+    // The static mode indexes with the VPN itself, and the table mode spreads the banks with
+    // offsets in the low bits of one hash. Both need the low bits, so they keep the modulo.
+    if (sim_mode == M_STATIC || sim_mode == M_DYNAMIC_ONE_HASH_WITH_TABLE) {
+      reduction = RangeReducer::Method::MODULO;
+    }
+    index_reduce = RangeReducer(frame_per_bank, reduction,
+                                sim_mode == M_DYNAMIC_ONE_HASH_XOR ? 32 : 64);
 
     print_info();
 
-    memory.resize(bank_count);
-    for (auto& bank : memory) {
-      bank.resize(frame_per_bank);
-    }
+    page_table = FlatPageTable<PageLocation>(bank_count * frame_per_bank);
+    memory = FrameStore((size_t)bank_count * frame_per_bank);
+    occupancy = OccupancyBitmap(memory.size());
+    frame_indices.resize(bank_count);
+    bank_hashes.resize(bank_count);
 
-    // Select a hash function according to the hash strategy
-    if (sim_mode == M_STATIC) {
-      indexer = &UniversalHashingSimulator::get_index_in_bank_static;
-    }
-    else if (sim_mode == M_DYNAMIC_INDIE_HASH) {
-      indexer = &UniversalHashingSimulator::get_index_in_bank_dynamic_indie;
-    }
-    else if (sim_mode == M_DYNAMIC_ONE_HASH) {
-      indexer = &UniversalHashingSimulator::get_index_in_bank_dynamic;
-    }
-    else if (sim_mode == M_DYNAMIC_ONE_HASH_XOR) {
-      indexer = &UniversalHashingSimulator::get_index_in_bank_dynamic_xor;
-    }
-    else if (sim_mode == M_DYNAMIC_ONE_HASH_WITH_TABLE) {
-      indexer = &UniversalHashingSimulator::get_index_in_bank_with_table;
+    // Select the simulation loops and hash functions according to the hash strategy
+    select_kernels();
+    if (sim_mode == M_DYNAMIC_ONE_HASH_WITH_TABLE) {
 
       std::mt19937 generator(1u);
       std::uniform_int_distribution<int> distribution(INT_MIN, INT_MAX);
@@ -81,84 +107,35 @@ public:
     }
   }
 
-  void access(uint64_t addr, char rw) override {
-    time_tick += 1;
-    stats.total_mem_access += 1;
-
-    uint64_t vpn = get_page_number(addr);
-    vpn_set.insert(vpn);
-
-    uint64_t vpn_hashed = 0;
-    if (sim_mode == M_DYNAMIC_ONE_HASH || sim_mode == M_DYNAMIC_ONE_HASH_WITH_TABLE) {
-      vpn_hashed = XXH64(&vpn, sizeof(vpn), 0);
-    }
+  void access_run(uint64_t vpn, uint64_t count, uint8_t rw_mask) override {
+    (this->*run_kernel)(vpn, count, rw_mask);
+  }
 
-    auto find_res = page_table.find(vpn);
+  void access_runs(const PageRun *runs, size_t n) override {
+    (this->*runs_kernel)(runs, n);
+  }
 
-    if (find_res != page_table.end()) {
-      // page is in the memory
-      uint32_t bank_idx = find_res->second;
-      uint32_t frame_idx = (this->*indexer)(vpn, vpn_hashed, bank_idx);
+  void prefetch_lookup(uint64_t vpn) const {
+    page_table.prefetch(vpn);
+  }
 
-      memory[bank_idx][frame_idx].timestamp = time_tick;
+  void prefetch_frame(uint64_t vpn) {
+    if (auto *loc = page_table.find(vpn)) {
+      __builtin_prefetch(&memory.timestamps[loc->slot], 1);
     }
-    else {
-      // page is not in the memory, should find a frame for it
-      stats.num_page_fault += 1;
-
-      uint32_t bank_selected = 0;
-      uint64_t min_lru_time = UINT64_MAX;
-      PageFrame *frame_selected = nullptr;
-
-      bool need_evict = true;
-
-      #ifdef DBG
-      printf("VPN: %lld\n", vpn);
-      printf("frame index: ");
-      
-      for (int bank = 0; bank < bank_count; bank++) {
-        uint32_t frame_idx = (this->*indexer)(vpn, vpn_hashed, bank);
-        printf("%u, ", frame_idx);
-      }
-      printf("\n");
-      #endif
-
-      // Check all possible frames, if an empty frame is found, occupy it without evicting a page.
-      // If there is no empty frame, evict a page according to the LRU policy.
-      for (int bank = 0; bank < bank_count; bank++) {
-
-        uint32_t frame_idx = (this->*indexer)(vpn, vpn_hashed, bank);
-        auto& the_frame = memory[bank][frame_idx];
-
-        if (the_frame.free) {
-          need_evict = false;
-          bank_selected = bank;
-          frame_selected = &the_frame;
-          break;
-        }
-
-        if (the_frame.timestamp < min_lru_time) {
-          min_lru_time = the_frame.timestamp;
-          bank_selected = bank;
-          frame_selected = &the_frame;
-        }
-      }
+  }
 
-      if (need_evict) {
-        // If it's the first swap, record memory utilization
-        if (stats.num_swap_out == 0) {
-          stats.mem_util_pct = (double)vpn_set.size() / (bank_count * frame_per_bank);
-        }
-        stats.num_swap_out += 1;
-        stats.total_age_of_swapped_out_pages += time_tick - frame_selected->timestamp;
-        page_table.erase(frame_selected->vpn);
-      }
+  void save_state(CheckpointWriter& out) override {
+    VmSimulator::save_state(out);
+    page_table.save(out);
+    memory.save(out);
+  }
 
-      page_table[vpn] = bank_selected;
-      frame_selected->vpn = vpn;
-      frame_selected->free = false;
-      frame_selected->timestamp = time_tick;
-    }
+  void load_state(CheckpointReader& in) override {
+    VmSimulator::load_state(in);
+    page_table.load(in);
+    memory.load(in);
+    occupancy.rebuild(memory);
   }
 
   virtual void print_info(std::ostream& os = std::cout) override {
@@ -167,6 +144,10 @@ public:
        << "\nsim_mode = " << sim_mode_name 
        << "\nbank_count = " << bank_count
        << "\nframe_per_bank = " << frame_per_bank
+       << "\nindex_reduction = " << index_reduce.name()
+       << "\nhash_family = " << hash_family::name(family)
+       << "\nframe_layout = "
+       << (frame_layout == FrameLayout::BANK_MAJOR ? "bank-major" : "index-major")
        << "\n" << std::endl;
   }
 
@@ -207,43 +188,257 @@ private:
     return (low32 ^ high32) & 0xFFFFFFFF;
   }
 
-  uint32_t get_index_in_bank_static(uint64_t vpn, uint64_t vpn_hashed, int bank_index) {
-    return vpn % (uint64_t)frame_per_bank;
+  // The simulation step, compiled once per hash mode and family H so the index computation is
+  // inlined, and per common bank count (BANKS != 0) so the loops over the banks have a fixed
+  // trip count.
+  template <Mode M, typename H, int BANKS>
+  void access_run_as(uint64_t vpn, uint64_t count, uint8_t rw_mask) {
+    time_tick += 1;
+    stats.total_mem_access += count;
+    // the page is stamped with the tick of the last access of the run
+    uint64_t last_tick = time_tick + count - 1;
+
+    footprint.insert(vpn);
+
+    auto *find_res = page_table.find(vpn);
+
+    if (find_res != nullptr) {
+      // page is in the memory
+      memory.timestamps[find_res->slot] = last_tick;
+    }
+    else {
+      // page is not in the memory, should find a frame for it
+      stats.num_page_fault += 1;
+
+      uint32_t bank_selected = 0;
+      size_t slot_selected = 0;
+      uint64_t min_lru_time = UINT64_MAX;
+
+      uint64_t vpn_hashed = 0;
+      if constexpr (M == M_DYNAMIC_ONE_HASH || M == M_DYNAMIC_ONE_HASH_WITH_TABLE) {
+        vpn_hashed = std::get<H>(policies).hash(vpn, 0);
+      }
+      fill_indices<M, H, BANKS>(vpn, vpn_hashed);
+
+      #ifdef DBG
+      printf("VPN: %lld\n", vpn);
+      printf("frame index: ");
+      
+      for (int bank = 0; bank < bank_count; bank++) {
+        printf("%u, ", frame_indices[bank]);
+      }
+      printf("\n");
+      #endif
+
+      // Check all possible frames, if an empty frame is found, occupy it without evicting a page.
+      // If there is no empty frame, evict a page according to the LRU policy.
+      // While memory fills up, free candidates are looked up in the occupancy bitmap, then the
+      // candidates' timestamps are scanned a chunk of banks at a time.
+      if (occupancy.free_frames() > 0) {
+        for (int bank = 0; bank < banks<BANKS>(); bank++) {
+          size_t slot = frame_slot(bank, frame_indices[bank]);
+          if (occupancy.free(slot)) {
+            min_lru_time = FREE_TIMESTAMP;
+            bank_selected = bank;
+            slot_selected = slot;
+            break;
+          }
+        }
+      }
+
+      uint32_t slots[victim_select::CHUNK_SIZE];
+      for (int first = 0; first < banks<BANKS>() && min_lru_time != FREE_TIMESTAMP;
+           first += victim_select::CHUNK_SIZE) {
+        size_t n = std::min<size_t>(victim_select::CHUNK_SIZE, banks<BANKS>() - first);
+        for (size_t i = 0; i < n; i++) {
+          slots[i] = frame_slot(first + i, frame_indices[first + i]);
+        }
+
+        size_t oldest = find_oldest(memory.timestamps.data(), slots, n);
+        uint64_t timestamp = memory.timestamps[slots[oldest]];
+        if (timestamp < min_lru_time) {
+          min_lru_time = timestamp;
+          bank_selected = first + oldest;
+          slot_selected = slots[oldest];
+          if (timestamp == FREE_TIMESTAMP) break;
+        }
+      }
+
+      if (min_lru_time != FREE_TIMESTAMP) {
+        // If it's the first swap, record memory utilization.
+        // Nothing was evicted so far, so every page fault brought in a distinct page.
+        if (stats.num_swap_out == 0) {
+          stats.mem_util_pct = (double)stats.num_page_fault / (bank_count * frame_per_bank);
+        }
+        stats.num_swap_out += 1;
+        stats.total_age_of_swapped_out_pages += time_tick - min_lru_time;
+        page_table.erase(memory.vpns[slot_selected]);
+      }
+
+      page_table.insert_or_assign(vpn, {(uint32_t)slot_selected, bank_selected});
+      occupancy.take(slot_selected);
+      memory.vpns[slot_selected] = vpn;
+      memory.timestamps[slot_selected] = last_tick;
+    }
+
+    time_tick = last_tick;
+  }
+
+  template <Mode M, typename H, int BANKS>
+  void access_runs_as(const PageRun *runs, size_t n) {
+    pipelined(runs, n, [this](const PageRun& run) {
+      access_run_as<M, H, BANKS>(run.vpn, run.count, run.rw_mask);
+    });
   }
 
-  // f(h(x), bank_index)
-  uint32_t get_index_in_bank_dynamic(uint64_t vpn, uint64_t vpn_hashed, int bank_index) {
-    uint64_t vpn_bank_mix =  vpn_hashed ^ (uint64_t)bank_index;
-    return XXH64(&vpn_bank_mix, sizeof(vpn_bank_mix), 0) % (uint64_t)frame_per_bank;
+  // Dispatch table from the hash mode named by the -s option to its simulation loops.
+  template <typename H, int BANKS>
+  void select_kernels_for() {
+    static constexpr std::pair<RunKernel, RunsKernel> kernels[] = {
+      { &UniversalHashingSimulator::access_run_as<M_STATIC, H, BANKS>,
+        &UniversalHashingSimulator::access_runs_as<M_STATIC, H, BANKS> },
+      { &UniversalHashingSimulator::access_run_as<M_DYNAMIC_INDIE_HASH, H, BANKS>,
+        &UniversalHashingSimulator::access_runs_as<M_DYNAMIC_INDIE_HASH, H, BANKS> },
+      { &UniversalHashingSimulator::access_run_as<M_DYNAMIC_ONE_HASH, H, BANKS>,
+        &UniversalHashingSimulator::access_runs_as<M_DYNAMIC_ONE_HASH, H, BANKS> },
+      { &UniversalHashingSimulator::access_run_as<M_DYNAMIC_ONE_HASH_WITH_TABLE, H, BANKS>,
+        &UniversalHashingSimulator::access_runs_as<M_DYNAMIC_ONE_HASH_WITH_TABLE, H, BANKS> },
+      { &UniversalHashingSimulator::access_run_as<M_DYNAMIC_ONE_HASH_XOR, H, BANKS>,
+        &UniversalHashingSimulator::access_runs_as<M_DYNAMIC_ONE_HASH_XOR, H, BANKS> },
+    };
+    run_kernel = kernels[sim_mode].first;
+    runs_kernel = kernels[sim_mode].second;
   }
 
-  uint32_t get_index_in_bank_with_table(uint64_t vpn, uint64_t vpn_hashed, int bank_index) {
+  // Common bank counts get loops compiled for them, any other runs the generic loops.
+  void select_kernels() {
+    hash_family::visit(family, [this](auto tag) {
+      using H = typename decltype(tag)::type;
+      switch (bank_count) {
+        case 64:
+          this->template select_kernels_for<H, 64>();
+          break;
+        case 128:
+          this->template select_kernels_for<H, 128>();
+          break;
+        default:
+          this->template select_kernels_for<H, 0>();
+          break;
+      }
+    });
+    // with whole chunks only, the victim kernel always scans CHUNK_SIZE candidates
+    if (bank_count % victim_select::CHUNK_SIZE == 0) {
+      find_oldest = victim_select::select_oldest_kernel<victim_select::CHUNK_SIZE>();
+    }
+  }
+
+  template <int BANKS>
+  int banks() const {
+    return BANKS != 0 ? BANKS : bank_count;
+  }
+
+  size_t frame_slot(uint32_t bank, uint32_t frame_idx) const {
+    return bank * bank_stride + frame_idx * index_stride;
+  }
+
+  // The 128 bits the xor mode slices per bank: XXH128 with the XXH64 family as before,
+  // otherwise the family's hashes with seeds 0 and 1.
+  template <typename H>
+  XXH128_hash_t hash128(uint64_t vpn) const {
+    if constexpr (std::is_same_v<H, hash_family::Xxh64>) {
+      return XXH128(&vpn, sizeof(vpn), 0);
+    }
+    else {
+      const H& h = std::get<H>(policies);
+      return {h.hash(vpn, 0), h.hash(vpn, 1)};
+    }
+  }
+
+  // Fill frame_indices with the frame index of the page in every bank. The VPN is hashed once
+  // where the mode allows it, otherwise the per-bank hashes run on lanes (SIMD lanes with XXH64).
+  template <Mode M, typename H, int BANKS>
+  void fill_indices(uint64_t vpn, uint64_t vpn_hashed) {
+    if constexpr (M == M_STATIC) {
+      fill_indices_static<H, BANKS>(vpn, vpn_hashed);
+    }
+    else if constexpr (M == M_DYNAMIC_INDIE_HASH) {
+      fill_indices_dynamic_indie<H, BANKS>(vpn, vpn_hashed);
+    }
+    else if constexpr (M == M_DYNAMIC_ONE_HASH) {
+      fill_indices_dynamic<H, BANKS>(vpn, vpn_hashed);
+    }
+    else if constexpr (M == M_DYNAMIC_ONE_HASH_WITH_TABLE) {
+      fill_indices_with_table<H, BANKS>(vpn, vpn_hashed);
+    }
+    else {
+      fill_indices_dynamic_xor<H, BANKS>(vpn, vpn_hashed);
+    }
+  }
+
+  template <typename H, int BANKS>
+  void fill_indices_static(uint64_t vpn, uint64_t vpn_hashed) {
+    // the same frame index in every bank
+    uint32_t idx = index_reduce(vpn);
+    std::fill_n(frame_indices.begin(), banks<BANKS>(), idx);
+  }
+
+  template <typename H, int BANKS>
+  void fill_indices_dynamic(uint64_t vpn, uint64_t vpn_hashed) {
+    std::get<H>(policies).hash_inputs(vpn_hashed, banks<BANKS>(), bank_hashes.data());
+    index_reduce.reduce_all(bank_hashes.data(), banks<BANKS>(), frame_indices.data());
+  }
+
+  template <typename H, int BANKS>
+  void fill_indices_with_table(uint64_t vpn, uint64_t vpn_hashed) {
     std::vector<int>& table_row = offset_table[vpn_hashed >> (64 - offset_table_size_bit)];
-    uint64_t idx = (vpn_hashed + table_row[bank_index]) % (uint64_t)frame_per_bank;
-    return idx;
+    for (int bank = 0; bank < banks<BANKS>(); bank++) {
+      bank_hashes[bank] = vpn_hashed + table_row[bank];
+    }
+    index_reduce.reduce_all(bank_hashes.data(), banks<BANKS>(), frame_indices.data());
   }
 
-  uint32_t get_index_in_bank_dynamic_xor(uint64_t vpn, uint64_t vpn_hashed, int bank_index) {
-    XXH128_hash_t res = XXH128(&vpn, sizeof(vpn), 0);
-    return xorBits(res.low64, res.high64, bank_index) % (uint64_t)frame_per_bank;
+  template <typename H, int BANKS>
+  void fill_indices_dynamic_xor(uint64_t vpn, uint64_t vpn_hashed) {
+    XXH128_hash_t res = hash128<H>(vpn);
+    for (int bank = 0; bank < banks<BANKS>(); bank++) {
+      bank_hashes[bank] = xorBits(res.low64, res.high64, bank);
+    }
+    index_reduce.reduce_all(bank_hashes.data(), banks<BANKS>(), frame_indices.data());
   }
 
-  uint32_t get_index_in_bank_dynamic_indie(uint64_t vpn, uint64_t vpn_hashed, int bank_index) {
-    return XXH64(&vpn, sizeof(vpn), bank_index) % (uint64_t)frame_per_bank;
+  template <typename H, int BANKS>
+  void fill_indices_dynamic_indie(uint64_t vpn, uint64_t vpn_hashed) {
+    std::get<H>(policies).hash_seeds(vpn, banks<BANKS>(), bank_hashes.data());
+    index_reduce.reduce_all(bank_hashes.data(), banks<BANKS>(), frame_indices.data());
   }
 
   int bank_count;
   int frame_per_bank;
-
-  // map VPN to CPFN
-  std::unordered_map<uint64_t, uint32_t> page_table;
-  std::vector<std::vector<PageFrame>> memory;
+  // maps a hash onto a frame index in a bank
+  RangeReducer index_reduce;
+  hash_family::Family family;
+  // the per-bank hashes use seeds 0 to bank_count - 1, the xor mode seeds 0 and 1
+  hash_family::Policies policies;
+  FrameLayout frame_layout;
+  size_t bank_stride;
+  size_t index_stride;
+
+  // map VPN to its frame slot and the bank holding it
+  FlatPageTable<PageLocation> page_table;
+  // frames of all banks in one arena, placed according to frame_layout
+  FrameStore memory;
+  OccupancyBitmap occupancy;
 
   std::string sim_mode_name;
   Mode sim_mode {Mode::M_DYNAMIC_ONE_HASH};
-  Indexer indexer {nullptr};
+  RunKernel run_kernel {nullptr};
+  RunsKernel runs_kernel {nullptr};
+
+  // scratch space of the index fillers, one entry per bank
+  std::vector<uint32_t> frame_indices;
+  std::vector<uint64_t> bank_hashes;
+  victim_select::OldestKernel find_oldest {victim_select::select_oldest_kernel()};
 
-  uint64_t time_tick {0};
 
   // for table-based secondary hash
   std::vector<std::vector<int>> offset_table;
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <immintrin.h>
+
+#include "page_frame.h"
+
+// Victim selection over the candidate frames of a page, one per bank. A kernel looks up the
+// timestamps of the frames at `slots` and returns the position of the first oldest one. Free
+// frames (FREE_TIMESTAMP) are the oldest possible, so a kernel stops at the first one it sees.
+//
+// The SIMD kernels gather 4 (AVX2) or 8 (AVX-512) timestamps at a time and keep the oldest
+// timestamp and its position per lane, so they return exactly what the scalar loop returns.
+// Slots are gathered through signed 32-bit indices and must stay below 2^31.
+//
+// Row kernels do the same over frames whose timestamps are contiguous, such as an iceberg yard,
+// with plain vector loads instead of gathers.
+//
+// A kernel instantiated with N != 0 ignores n and always looks at N frames, so a simulator
+// whose candidate count is fixed gets loops with a constant trip count.
+namespace victim_select {
+
+// number of candidates handed to a kernel at once by the simulators
+constexpr size_t CHUNK_SIZE = 16;
+
+// Where a kernel reads the candidate timestamps from. Both the gather kernels and the row kernels
+// run the same reductions below over one of these, so they pick the same victim.
+//   ts[i]:               timestamp of candidate i
+//   load4(i):            timestamps of candidates i..i+3
+//   load8(i, live):      timestamps of the live candidates among i..i+7, -1 in the other lanes
+
+// the candidates' timestamps are gathered through their slots
+struct GatheredTimestamps {
+  const uint64_t *timestamps;
+  const uint32_t *slots;
+
+  uint64_t operator[](size_t i) const { return timestamps[slots[i]]; }
+
+  __attribute__((target("avx2")))
+  __m256i load4(size_t i) const {
+    __m128i idx = _mm_loadu_si128(reinterpret_cast<const __m128i *>(slots + i));
+    return _mm256_i32gather_epi64(reinterpret_cast<const long long *>(timestamps), idx, 8);
+  }
+
+  __attribute__((target("avx512f,avx512vl")))
+  __m512i load8(size_t i, __mmask8 live) const {
+    // lanes past the end read nothing and keep the largest timestamp
+    __m256i idx = _mm256_maskz_loadu_epi32(live, slots + i);
+    return _mm512_mask_i32gather_epi64(_mm512_set1_epi64(-1), live, idx,
+                                       reinterpret_cast<const long long *>(timestamps), 8);
+  }
+};
+
+// the candidates' timestamps are contiguous
+struct RowTimestamps {
+  const uint64_t *timestamps;
+
+  uint64_t operator[](size_t i) const { return timestamps[i]; }
+
+  __attribute__((target("avx2")))
+  __m256i load4(size_t i) const {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(timestamps + i));
+  }
+
+  __attribute__((target("avx512f,avx512vl")))
+  __m512i load8(size_t i, __mmask8 live) const {
+    return _mm512_mask_loadu_epi64(_mm512_set1_epi64(-1), live, timestamps + i);
+  }
+};
+
+template <size_t N, typename Timestamps>
+inline size_t oldest_scalar(Timestamps ts, size_t n) {
+  if (N != 0) n = N;
+  size_t oldest = 0;
+  uint64_t oldest_ts = UINT64_MAX;
+  for (size_t i = 0; i < n; i++) {
+    uint64_t timestamp = ts[i];
+    if (timestamp == FREE_TIMESTAMP) return i;
+    if (timestamp < oldest_ts) {
+      oldest_ts = timestamp;
+      oldest = i;
+    }
+  }
+  return oldest;
+}
+
+template <size_t N, typename Timestamps>
+__attribute__((target("avx2")))
+inline size_t oldest_avx2(Timestamps ts, size_t n) {
+  if (N != 0) n = N;
+  // timestamps stay far below 2^63, so signed comparisons order them correctly
+  __m256i oldest = _mm256_set1_epi64x(INT64_MAX);
+  __m256i oldest_pos = _mm256_setzero_si256();
+  __m256i pos = _mm256_setr_epi64x(0, 1, 2, 3);
+
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i lane_ts = ts.load4(i);
+
+    int free = _mm256_movemask_pd(
+        _mm256_castsi256_pd(_mm256_cmpeq_epi64(lane_ts, _mm256_set1_epi64x(FREE_TIMESTAMP))));
+    if (free != 0) return i + __builtin_ctz(free);
+
+    __m256i older = _mm256_cmpgt_epi64(oldest, lane_ts);
+    oldest = _mm256_blendv_epi8(oldest, lane_ts, older);
+    oldest_pos = _mm256_blendv_epi8(oldest_pos, pos, older);
+    pos = _mm256_add_epi64(pos, _mm256_set1_epi64x(4));
+  }
+
+  // across lanes: the smallest timestamp, at the smallest position among equal ones
+  alignas(32) uint64_t lane_ts[4], lane_pos[4];
+  _mm256_store_si256(reinterpret_cast<__m256i *>(lane_ts), oldest);
+  _mm256_store_si256(reinterpret_cast<__m256i *>(lane_pos), oldest_pos);
+  uint64_t best_ts = INT64_MAX;
+  size_t best = 0;
+  for (int lane = 0; lane < 4; lane++) {
+    if (lane_ts[lane] < best_ts || (lane_ts[lane] == best_ts && lane_pos[lane] < best)) {
+      best_ts = lane_ts[lane];
+      best = lane_pos[lane];
+    }
+  }
+
+  for (; i < n; i++) {
+    uint64_t timestamp = ts[i];
+    if (timestamp == FREE_TIMESTAMP) return i;
+    if (timestamp < best_ts) {
+      best_ts = timestamp;
+      best = i;
+    }
+  }
+  return best;
+}
+
+template <size_t N, typename Timestamps>
+__attribute__((target("avx512f,avx512vl")))
+inline size_t oldest_avx512(Timestamps ts, size_t n) {
+  if (N != 0) n = N;
+  __m512i oldest = _mm512_set1_epi64(-1);
+  __m512i oldest_pos = _mm512_setzero_si512();
+  __m512i pos = _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+
+  for (size_t i = 0; i < n; i += 8) {
+    __mmask8 live = n - i >= 8 ? 0xff : (1u << (n - i)) - 1;
+    __m512i lane_ts = ts.load8(i, live);
+
+    __mmask8 free = _mm512_mask_cmpeq_epu64_mask(live, lane_ts,
+                                                 _mm512_set1_epi64(FREE_TIMESTAMP));
+    if (free != 0) return i + __builtin_ctz(free);
+
+    __mmask8 older = _mm512_cmplt_epu64_mask(lane_ts, oldest);
+    oldest = _mm512_mask_mov_epi64(oldest, older, lane_ts);
+    oldest_pos = _mm512_mask_mov_epi64(oldest_pos, older, pos);
+    pos = _mm512_add_epi64(pos, _mm512_set1_epi64(8));
+  }
+
+  uint64_t best_ts = _mm512_reduce_min_epu64(oldest);
+  __mmask8 best_lanes = _mm512_cmpeq_epu64_mask(oldest, _mm512_set1_epi64(best_ts));
+  return _mm512_mask_reduce_min_epu64(best_lanes, oldest_pos);
+}
+
+using OldestKernel = size_t (*)(const uint64_t *timestamps, const uint32_t *slots, size_t n);
+
+template <size_t N = 0>
+inline size_t find_oldest_scalar(const uint64_t *timestamps, const uint32_t *slots, size_t n) {
+  return oldest_scalar<N>(GatheredTimestamps {timestamps, slots}, n);
+}
+
+template <size_t N = 0>
+__attribute__((target("avx2")))
+inline size_t find_oldest_avx2(const uint64_t *timestamps, const uint32_t *slots, size_t n) {
+  return oldest_avx2<N>(GatheredTimestamps {timestamps, slots}, n);
+}
+
+template <size_t N = 0>
+__attribute__((target("avx512f,avx512vl")))
+inline size_t find_oldest_avx512(const uint64_t *timestamps, const uint32_t *slots, size_t n) {
+  return oldest_avx512<N>(GatheredTimestamps {timestamps, slots}, n);
+}
+
+using OldestRowKernel = size_t (*)(const uint64_t *timestamps, size_t n);
+
+template <size_t N = 0>
+inline size_t find_oldest_row_scalar(const uint64_t *timestamps, size_t n) {
+  return oldest_scalar<N>(RowTimestamps {timestamps}, n);
+}
+
+template <size_t N = 0>
+__attribute__((target("avx2")))
+inline size_t find_oldest_row_avx2(const uint64_t *timestamps, size_t n) {
+  return oldest_avx2<N>(RowTimestamps {timestamps}, n);
+}
+
+template <size_t N = 0>
+__attribute__((target("avx512f,avx512vl")))
+inline size_t find_oldest_row_avx512(const uint64_t *timestamps, size_t n) {
+  return oldest_avx512<N>(RowTimestamps {timestamps}, n);
+}
+
+template <size_t N = 0>
+inline OldestKernel select_oldest_kernel() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl")) {
+    return find_oldest_avx512<N>;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return find_oldest_avx2<N>;
+  }
+  return find_oldest_scalar<N>;
+}
+
+template <size_t N = 0>
+inline OldestRowKernel select_oldest_row_kernel() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl")) {
+    return find_oldest_row_avx512<N>;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return find_oldest_row_avx2<N>;
+  }
+  return find_oldest_row_scalar<N>;
+}
+
+}  // namespace victim_select
@@ -1,24 +1,127 @@
 #pragma once
 
+#include "checkpoint.h"
+#include "constants+helper.h"
+#include "footprint_tracker.h"
+#include "trace_record.h"
 #include "vm_stats.h"
 
+#include <algorithm>
 #include <iostream>
-#include <unordered_set>
+#include <iterator>
 
 class VmSimulator {
 public:
   virtual void access(uint64_t addr, char rw) = 0;
 
+  // Simulates `count` consecutive accesses to page `vpn`, with exactly the same effect on the
+  // state and statistics as calling access() for each of them. `rw_mask` holds the
+  // ACCESS_* bits of the access types in the run.
+  virtual void access_run(uint64_t vpn, uint64_t count, uint8_t rw_mask) = 0;
+
+  // Simulates `n` page runs in order, same as access_run() on each of them.
+  virtual void access_runs(const PageRun *runs, size_t n) = 0;
+
+  // Simulates `n` trace records in order, same as access() on each of them, except that the
+  // page of a record is tagged with its address space ID.
+  virtual void access_batch(const TraceRecord *records, size_t n) = 0;
+
+  // Lets time pass for `count` accesses that are not simulated, see SampledSimulator.
+  void advance_time(uint64_t count) {
+    time_tick += count;
+  }
+
   virtual vm_stats get_stats() {
-    stats.total_page_access = vpn_set.size();
+    stats.total_page_access = footprint.size();
     return stats;
   }
 
+  // Selects how distinct pages are counted, see FootprintTracker. Must be called before the
+  // first access.
+  virtual void set_footprint_mode(FootprintTracker::Mode mode) {
+    footprint.set_mode(mode);
+  }
+
+  // Cheaper than get_stats(), used to attribute page faults to traces while simulating.
+  // Counts only the simulated pages when sampling.
+  virtual uint64_t get_page_faults() {
+    return stats.num_page_fault;
+  }
+
   virtual void print_info(std::ostream& os = std::cout) {}
 
+  // Save/restore the complete simulation state, used to resume long runs.
+  // Overrides should call the base version first.
+  virtual void save_state(CheckpointWriter& out) {
+    out.write(stats);
+    out.write(time_tick);
+    footprint.save(out);
+  }
+
+  virtual void load_state(CheckpointReader& in) {
+    in.read(stats);
+    in.read(time_tick);
+    footprint.load(in);
+  }
+
   virtual ~VmSimulator() {};
 
 protected:
   vm_stats stats;
-  std::unordered_set<uint64_t> vpn_set;
+  uint64_t time_tick {0};
+  // distinct pages accessed
+  FootprintTracker footprint;
+};
+
+// Base of the concrete simulators. Derived is final, so the calls below bind statically and
+// a whole batch of runs is one virtual call, with access_run() inlined into the loop.
+//
+// Batches are software pipelined: while run i is simulated, Derived::prefetch_lookup() pulls
+// in the page table slot of run i + PREFETCH_DISTANCE and Derived::prefetch_frame() the frame
+// of the page of run i + PREFETCH_DISTANCE / 2, whose lookup then hits the cache.
+template <typename Derived>
+class SimulatorKernel : public VmSimulator {
+public:
+  static constexpr size_t PREFETCH_DISTANCE = 8;
+
+  void access(uint64_t addr, char rw) override {
+    derived().access_run(get_page_number(addr), 1, get_access_type_mask(rw));
+  }
+
+  void access_runs(const PageRun *runs, size_t n) override {
+    pipelined(runs, n, [this](const PageRun& run) {
+      derived().access_run(run.vpn, run.count, run.rw_mask);
+    });
+  }
+
+  void access_batch(const TraceRecord *records, size_t n) override {
+    PageRun runs[256];
+    for (size_t first = 0; first < n; first += std::size(runs)) {
+      size_t cnt = std::min(n - first, std::size(runs));
+      for (size_t i = 0; i < cnt; i++) {
+        const TraceRecord& record = records[first + i];
+        runs[i] = {get_tagged_page_number(record.addr, record.asid), 1,
+                   get_access_type_mask(record.rw), record.asid};
+      }
+      derived().access_runs(runs, cnt);
+    }
+  }
+
+protected:
+  // Calls step() on every run, prefetching for the runs ahead.
+  template <typename Step>
+  void pipelined(const PageRun *runs, size_t n, Step step) {
+    for (size_t i = 0; i < n; i++) {
+      if (i + PREFETCH_DISTANCE < n) {
+        derived().prefetch_lookup(runs[i + PREFETCH_DISTANCE].vpn);
+      }
+      if (i + PREFETCH_DISTANCE / 2 < n) {
+        derived().prefetch_frame(runs[i + PREFETCH_DISTANCE / 2].vpn);
+      }
+      step(runs[i]);
+    }
+  }
+
+private:
+  Derived& derived() { return static_cast<Derived&>(*this); }
 };
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs the same task on a fixed set of workers and waits for all of them, like a barrier.
+// The calling thread acts as worker 0, so a pool of n workers owns n - 1 threads.
+class WorkerPool {
+public:
+  using Task = std::function<void(size_t worker)>;
+
+  explicit WorkerPool(size_t worker_count) {
+    for (size_t i = 1; i < worker_count; i++) {
+      threads.emplace_back(&WorkerPool::work, this, i);
+    }
+  }
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  ~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+      generation++;
+    }
+    task_ready.notify_all();
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+  size_t size() const { return threads.size() + 1; }
+
+  // Runs task(i) for every worker i in parallel, returns when all of them are done.
+  void run(const Task& task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      current = &task;
+      pending = threads.size();
+      generation++;
+    }
+    task_ready.notify_all();
+
+    task(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    task_done.wait(lock, [this] { return pending == 0; });
+    current = nullptr;
+  }
+
+private:
+  void work(size_t worker) {
+    uint64_t seen = 0;
+    while (true) {
+      const Task *task;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        task_ready.wait(lock, [&] { return generation != seen; });
+        seen = generation;
+        if (stopping) return;
+        task = current;
+      }
+
+      (*task)(worker);
+
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--pending == 0) {
+        task_done.notify_one();
+      }
+    }
+  }
+
+  std::vector<std::thread> threads;
+
+  std::mutex mutex;
+  std::condition_variable task_ready;
+  std::condition_variable task_done;
+  const Task *current {nullptr};
+  size_t pending {0};
+  uint64_t generation {0};
+  bool stopping {false};
+};
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <immintrin.h>
+
+// XXH64 of single 8-byte values, computed for many banks at once. For an 8-byte input the
+// whole of XXH64 is a handful of multiplies and rotates, so it is spelled out here and run
+// on 4 (AVX2) or 8 (AVX-512) lanes. Every kernel returns exactly XXH64(&value, 8, seed).
+//
+// Two families match the per-bank hashes of the universal hashing simulator:
+//   seed lanes:  out[i] = XXH64(input, seed = i)
+//   input lanes: out[i] = XXH64(input ^ i, seed = 0)
+namespace xxh64_lanes {
+
+constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+using LaneHasher = void (*)(uint64_t input, size_t n, uint64_t *out);
+
+inline uint64_t rotl(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t hash8(uint64_t input, uint64_t seed) {
+  uint64_t h = seed + PRIME64_5 + 8;
+  h ^= rotl(input * PRIME64_2, 31) * PRIME64_1;
+  h = rotl(h, 27) * PRIME64_1 + PRIME64_4;
+  h ^= h >> 33;
+  h *= PRIME64_2;
+  h ^= h >> 29;
+  h *= PRIME64_3;
+  h ^= h >> 32;
+  return h;
+}
+
+inline void hash_seeds_scalar(uint64_t input, size_t n, uint64_t *out) {
+  for (size_t i = 0; i < n; i++) {
+    out[i] = hash8(input, i);
+  }
+}
+
+inline void hash_inputs_scalar(uint64_t input, size_t n, uint64_t *out) {
+  for (size_t i = 0; i < n; i++) {
+    out[i] = hash8(input ^ i, 0);
+  }
+}
+
+// AVX2 has no 64-bit multiply, build it from 32-bit halves.
+__attribute__((target("avx2")))
+inline __m256i mullo64_avx2(__m256i a, uint64_t b) {
+  __m256i b_lo = _mm256_set1_epi64x(b & 0xffffffff);
+  __m256i b_hi = _mm256_set1_epi64x(b >> 32);
+  __m256i lo = _mm256_mul_epu32(a, b_lo);
+  __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b_lo),
+                                   _mm256_mul_epu32(a, b_hi));
+  return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+__attribute__((target("avx2")))
+inline __m256i rotl_avx2(__m256i x, int r) {
+  return _mm256_or_si256(_mm256_slli_epi64(x, r), _mm256_srli_epi64(x, 64 - r));
+}
+
+__attribute__((target("avx2")))
+inline __m256i hash8_avx2(__m256i input, __m256i seed) {
+  __m256i h = _mm256_add_epi64(seed, _mm256_set1_epi64x(PRIME64_5 + 8));
+  __m256i k = mullo64_avx2(rotl_avx2(mullo64_avx2(input, PRIME64_2), 31), PRIME64_1);
+  h = _mm256_xor_si256(h, k);
+  h = _mm256_add_epi64(mullo64_avx2(rotl_avx2(h, 27), PRIME64_1),
+                       _mm256_set1_epi64x(PRIME64_4));
+  h = _mm256_xor_si256(h, _mm256_srli_epi64(h, 33));
+  h = mullo64_avx2(h, PRIME64_2);
+  h = _mm256_xor_si256(h, _mm256_srli_epi64(h, 29));
+  h = mullo64_avx2(h, PRIME64_3);
+  return _mm256_xor_si256(h, _mm256_srli_epi64(h, 32));
+}
+
+__attribute__((target("avx2")))
+inline void hash_seeds_avx2(uint64_t input, size_t n, uint64_t *out) {
+  __m256i in = _mm256_set1_epi64x(input);
+  __m256i lane = _mm256_setr_epi64x(0, 1, 2, 3);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i seed = _mm256_add_epi64(lane, _mm256_set1_epi64x(i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), hash8_avx2(in, seed));
+  }
+  for (; i < n; i++) {
+    out[i] = hash8(input, i);
+  }
+}
+
+__attribute__((target("avx2")))
+inline void hash_inputs_avx2(uint64_t input, size_t n, uint64_t *out) {
+  __m256i lane = _mm256_setr_epi64x(0, 1, 2, 3);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i in = _mm256_xor_si256(_mm256_set1_epi64x(input),
+                                  _mm256_add_epi64(lane, _mm256_set1_epi64x(i)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i),
+                        hash8_avx2(in, _mm256_setzero_si256()));
+  }
+  for (; i < n; i++) {
+    out[i] = hash8(input ^ i, 0);
+  }
+}
+
+__attribute__((target("avx512f,avx512dq")))
+inline __m512i hash8_avx512(__m512i input, __m512i seed) {
+  __m512i h = _mm512_add_epi64(seed, _mm512_set1_epi64(PRIME64_5 + 8));
+  __m512i k = _mm512_mullo_epi64(
+      _mm512_rol_epi64(_mm512_mullo_epi64(input, _mm512_set1_epi64(PRIME64_2)), 31),
+      _mm512_set1_epi64(PRIME64_1));
+  h = _mm512_xor_si512(h, k);
+  h = _mm512_add_epi64(_mm512_mullo_epi64(_mm512_rol_epi64(h, 27), _mm512_set1_epi64(PRIME64_1)),
+                       _mm512_set1_epi64(PRIME64_4));
+  h = _mm512_xor_si512(h, _mm512_srli_epi64(h, 33));
+  h = _mm512_mullo_epi64(h, _mm512_set1_epi64(PRIME64_2));
+  h = _mm512_xor_si512(h, _mm512_srli_epi64(h, 29));
+  h = _mm512_mullo_epi64(h, _mm512_set1_epi64(PRIME64_3));
+  return _mm512_xor_si512(h, _mm512_srli_epi64(h, 32));
+}
+
+__attribute__((target("avx512f,avx512dq")))
+inline void hash_seeds_avx512(uint64_t input, size_t n, uint64_t *out) {
+  __m512i in = _mm512_set1_epi64(input);
+  __m512i lane = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+  for (size_t i = 0; i < n; i += 8) {
+    __mmask8 live = n - i >= 8 ? 0xff : (1u << (n - i)) - 1;
+    __m512i seed = _mm512_add_epi64(lane, _mm512_set1_epi64(i));
+    _mm512_mask_storeu_epi64(out + i, live, hash8_avx512(in, seed));
+  }
+}
+
+__attribute__((target("avx512f,avx512dq")))
+inline void hash_inputs_avx512(uint64_t input, size_t n, uint64_t *out) {
+  __m512i lane = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+  for (size_t i = 0; i < n; i += 8) {
+    __mmask8 live = n - i >= 8 ? 0xff : (1u << (n - i)) - 1;
+    __m512i in = _mm512_xor_si512(_mm512_set1_epi64(input),
+                                  _mm512_add_epi64(lane, _mm512_set1_epi64(i)));
+    _mm512_mask_storeu_epi64(out + i, live, hash8_avx512(in, _mm512_setzero_si512()));
+  }
+}
+
+inline bool has_avx512() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq");
+}
+
+inline LaneHasher select_seed_hasher() {
+  if (has_avx512()) return hash_seeds_avx512;
+  if (__builtin_cpu_supports("avx2")) return hash_seeds_avx2;
+  return hash_seeds_scalar;
+}
+
+inline LaneHasher select_input_hasher() {
+  if (has_avx512()) return hash_inputs_avx512;
+  if (__builtin_cpu_supports("avx2")) return hash_inputs_avx2;
+  return hash_inputs_scalar;
+}
+
+}  // namespace xxh64_lanes